@@ -12,7 +12,7 @@ class EnttSnapshot(ConanFile):
     default_options = {"shared": True, "only_lib": True}
     generators = "cmake", "VSCodeProperties"
     requires = ["code_cpp_props/0.1", "cereal/1.3.1", "entt/3.9.0"]
-    exports_sources = "include*", "src*", "CMakeLists.txt"
+    exports_sources = "include*", "src*", "tools*", "CMakeLists.txt"
 
     def build(self):
         cmake = CMake(self)
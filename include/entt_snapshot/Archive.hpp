@@ -1,5 +1,6 @@
 #pragma once
 
+#include <entt_snapshot/BufferArchive.hpp>
 #include <entt_snapshot/include_proxy/cereal.hpp>
 
 namespace snapshot {
@@ -13,17 +14,25 @@ public:
     if (binary) {
       binary->operator()(std::forward<TArgs>(args)...);
 
+    } else if (portable) {
+      portable->operator()(std::forward<TArgs>(args)...);
+    } else if (buffer) {
+      buffer->operator()(std::forward<TArgs>(args)...);
     } else {
       json->operator()(std::forward<TArgs>(args)...);
     }
   }
 
   OutputArchive(cereal::BinaryOutputArchive& binary);
+  OutputArchive(cereal::PortableBinaryOutputArchive& portable);
   OutputArchive(cereal::JSONOutputArchive& json);
+  OutputArchive(BufferOutputArchive& buffer);
 
 private:
   cereal::BinaryOutputArchive* binary;
+  cereal::PortableBinaryOutputArchive* portable;
   cereal::JSONOutputArchive* json;
+  BufferOutputArchive* buffer;
 };
 
 class InputArchive
@@ -34,17 +43,30 @@ public:
   {
     if (binary) {
       binary->operator()(std::forward<TArgs>(args)...);
+    } else if (portable) {
+      portable->operator()(std::forward<TArgs>(args)...);
+    } else if (buffer) {
+      buffer->operator()(std::forward<TArgs>(args)...);
     } else {
       json->operator()(std::forward<TArgs>(args)...);
     }
   }
 
+  /**
+   * The wrapped archive if it is a BufferInputArchive, null otherwise.
+   * */
+  inline BufferInputArchive* bufferArchive() const noexcept { return buffer; }
+
   InputArchive(cereal::BinaryInputArchive& binary);
+  InputArchive(cereal::PortableBinaryInputArchive& portable);
   InputArchive(cereal::JSONInputArchive& json);
+  InputArchive(BufferInputArchive& buffer);
 
 private:
   cereal::BinaryInputArchive* binary;
+  cereal::PortableBinaryInputArchive* portable;
   cereal::JSONInputArchive* json;
+  BufferInputArchive* buffer;
 };
 
 class Archive
@@ -55,28 +77,44 @@ public:
   {
     if (binary_out) {
       binary_out->operator()(std::forward<TArgs>(args)...);
+    } else if (portable_out) {
+      portable_out->operator()(std::forward<TArgs>(args)...);
     } else if (json_out) {
       json_out->operator()(std::forward<TArgs>(args)...);
+    } else if (buffer_out) {
+      buffer_out->operator()(std::forward<TArgs>(args)...);
     } else if (binary_in) {
       binary_in->operator()(std::forward<TArgs>(args)...);
+    } else if (portable_in) {
+      portable_in->operator()(std::forward<TArgs>(args)...);
+    } else if (buffer_in) {
+      buffer_in->operator()(std::forward<TArgs>(args)...);
     } else {
       json_in->operator()(std::forward<TArgs>(args)...);
     }
   }
 
   Archive(cereal::BinaryOutputArchive&);
+  Archive(cereal::PortableBinaryOutputArchive&);
   Archive(cereal::JSONOutputArchive&);
+  Archive(BufferOutputArchive&);
   Archive(cereal::BinaryInputArchive&);
+  Archive(cereal::PortableBinaryInputArchive&);
   Archive(cereal::JSONInputArchive&);
+  Archive(BufferInputArchive&);
 
 private:
   void setNull();
 
 private:
   cereal::BinaryOutputArchive* binary_out;
+  cereal::PortableBinaryOutputArchive* portable_out;
   cereal::JSONOutputArchive* json_out;
+  BufferOutputArchive* buffer_out;
   cereal::BinaryInputArchive* binary_in;
+  cereal::PortableBinaryInputArchive* portable_in;
   cereal::JSONInputArchive* json_in;
+  BufferInputArchive* buffer_in;
 };
 
 } // namespace snapshot
\ No newline at end of file
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <entt_snapshot/include_proxy/cereal.hpp>
+
+namespace snapshot {
+
+/**
+ * Binary archive writing directly into memory instead of a std::ostream,
+ * producing the same encoding as cereal::BinaryOutputArchive. Either appends
+ * to a growable buffer, whose capacity grows geometrically and which isn't
+ * zero-filled ahead of the writes, or writes into a fixed buffer, throwing
+ * once it is exhausted.
+ *
+ * Records are encoded in place and their size is patched afterwards.
+ * */
+class BufferOutputArchive
+  : public cereal::OutputArchive<BufferOutputArchive,
+                                 cereal::AllowEmptyClassElision>
+{
+public:
+  void saveBinary(void const* data, std::size_t size)
+  {
+    if (growable) {
+      auto bytes = static_cast<std::byte const*>(data);
+      growable->insert(growable->end(), bytes, bytes + size);
+    } else {
+      if (capacity - position < size) {
+        throw cereal::Exception("BufferOutputArchive: buffer exhausted");
+      }
+      std::memcpy(begin + position, data, size);
+    }
+    position += size;
+  }
+
+  /**
+   * Writes the encoding of encode, which is passed a fresh archive writing
+   * into the same buffer, prefixed by its size.
+   * */
+  template<typename Func>
+  void saveRecord(Func&& encode)
+  {
+    auto size = cereal::size_type{ 0 };
+    auto size_position = position;
+    saveBinary(&size, sizeof(size));
+
+    auto record = BufferOutputArchive{ RecordTag{}, *this };
+    encode(record);
+    position = record.position;
+
+    size = static_cast<cereal::size_type>(position - size_position -
+                                          sizeof(size));
+    auto data = growable ? growable->data() : begin;
+    std::memcpy(data + size_position, &size, sizeof(size));
+  }
+
+  /**
+   * Number of bytes written, for growable buffers including the bytes the
+   * buffer contained before.
+   * */
+  std::size_t size() const noexcept { return position; }
+
+  explicit BufferOutputArchive(std::vector<std::byte>& buffer);
+  explicit BufferOutputArchive(std::span<std::byte> buffer);
+
+private:
+  struct RecordTag
+  {};
+
+  /**
+   * Archive for a record, continuing at the parent's position.
+   * */
+  BufferOutputArchive(RecordTag, BufferOutputArchive const& parent);
+
+private:
+  std::vector<std::byte>* growable;
+  /**
+   * Fixed buffer, unused for growable ones.
+   * */
+  std::byte* begin;
+  std::size_t capacity;
+  std::size_t position;
+};
+
+/**
+ * Binary archive reading directly from memory instead of a std::istream,
+ * reads the encoding of cereal::BinaryOutputArchive. Records are decoded by an
+ * archive over just the record and skipped records aren't copied. Reads are
+ * bounds checked against their record, since a corrupted record may claim
+ * less bytes than its components decode, except for values of a fixed size
+ * encoding, see loadFixed.
+ * */
+class BufferInputArchive
+  : public cereal::InputArchive<BufferInputArchive,
+                                cereal::AllowEmptyClassElision>
+{
+public:
+  void loadBinary(void* data, std::size_t size)
+  {
+    if (checked && buffer.size() - position < size) {
+      throw cereal::Exception("BufferInputArchive: read past end of buffer");
+    }
+    std::memcpy(data, buffer.data() + position, size);
+    position += size;
+  }
+
+  /**
+   * Reads the next record, which is passed to decode as archive over just
+   * the record if decode is set, and skipped otherwise.
+   * */
+  template<typename Func>
+  void loadRecord(bool decode, Func&& func)
+  {
+    auto size = cereal::size_type{ 0 };
+    loadBinary(&size, sizeof(size));
+    if (buffer.size() - position < size) {
+      throw cereal::Exception("BufferInputArchive: record exceeds buffer");
+    }
+
+    if (decode) {
+      auto record = BufferInputArchive{ buffer.subspan(position, size) };
+      func(record);
+    }
+    position += size;
+  }
+
+  /**
+   * Decodes value, whose encoding has the same size for every value of T,
+   * e.g. trivially copyable components. The remaining bytes are checked once
+   * against encoded_size, the size of previous encodings, and the value is
+   * read unchecked; throws afterwards if the encoding turned out larger.
+   * Without a previous encoding, value is read checked and sets
+   * encoded_size.
+   * */
+  template<typename T>
+  void loadFixed(T& value, std::size_t& encoded_size)
+  {
+    auto start = position;
+    if (encoded_size == 0 || buffer.size() - position < encoded_size) {
+      (*this)(value);
+      encoded_size = position - start;
+      return;
+    }
+
+    checked = false;
+    try {
+      (*this)(value);
+    } catch (...) {
+      checked = true;
+      throw;
+    }
+    checked = true;
+    if (position - start > encoded_size) {
+      throw cereal::Exception("BufferInputArchive: encoding size changed");
+    }
+  }
+
+  /**
+   * Number of bytes read.
+   * */
+  std::size_t size() const noexcept { return position; }
+
+  explicit BufferInputArchive(std::span<std::byte const> buffer);
+
+private:
+  std::span<std::byte const> buffer;
+  std::size_t position;
+  bool checked;
+};
+
+template<class T>
+inline std::enable_if_t<std::is_arithmetic_v<T>>
+CEREAL_SAVE_FUNCTION_NAME(BufferOutputArchive& archive, T const& t)
+{
+  archive.saveBinary(std::addressof(t), sizeof(t));
+}
+
+template<class T>
+inline std::enable_if_t<std::is_arithmetic_v<T>>
+CEREAL_LOAD_FUNCTION_NAME(BufferInputArchive& archive, T& t)
+{
+  archive.loadBinary(std::addressof(t), sizeof(t));
+}
+
+template<class Archive, class T>
+inline CEREAL_ARCHIVE_RESTRICT(BufferInputArchive, BufferOutputArchive)
+  CEREAL_SERIALIZE_FUNCTION_NAME(Archive& archive,
+                                 cereal::NameValuePair<T>& t)
+{
+  archive(t.value);
+}
+
+template<class Archive, class T>
+inline CEREAL_ARCHIVE_RESTRICT(BufferInputArchive, BufferOutputArchive)
+  CEREAL_SERIALIZE_FUNCTION_NAME(Archive& archive, cereal::SizeTag<T>& t)
+{
+  archive(t.size);
+}
+
+template<class T>
+inline void
+CEREAL_SAVE_FUNCTION_NAME(BufferOutputArchive& archive,
+                          cereal::BinaryData<T> const& data)
+{
+  archive.saveBinary(data.data, static_cast<std::size_t>(data.size));
+}
+
+template<class T>
+inline void
+CEREAL_LOAD_FUNCTION_NAME(BufferInputArchive& archive,
+                          cereal::BinaryData<T>& data)
+{
+  archive.loadBinary(data.data, static_cast<std::size_t>(data.size));
+}
+
+} // namespace snapshot
+
+CEREAL_REGISTER_ARCHIVE(snapshot::BufferOutputArchive)
+CEREAL_REGISTER_ARCHIVE(snapshot::BufferInputArchive)
+CEREAL_SETUP_ARCHIVE_TRAITS(snapshot::BufferInputArchive,
+                            snapshot::BufferOutputArchive)
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Reflection.hpp"
+#include "Snapshot.hpp"
+
+namespace snapshot {
+
+struct ComponentChecksum
+{
+  std::string name;
+  std::uint64_t hash;
+
+  bool operator==(ComponentChecksum const&) const = default;
+};
+
+struct RegistryChecksum
+{
+  std::uint64_t hash;
+  /**
+   * Sorted by name.
+   * */
+  std::vector<ComponentChecksum> components;
+
+  /**
+   * Names of components whose hash differs from (or which are missing in)
+   * other. Allows incremental saves to skip unchanged component types.
+   * */
+  std::vector<std::string> changed(RegistryChecksum const& other) const;
+
+  bool operator==(RegistryChecksum const& other) const
+  {
+    return hash == other.hash;
+  }
+};
+
+/**
+ * Stable hash of the reflected state of a registry. Independent of the
+ * storages' order, thus a loaded registry hashes equal to the saved one.
+ * */
+class Checksum
+{
+public:
+  static RegistryChecksum compute(entt::registry const&, ShouldSerializePred);
+
+  /**
+   * Storages smaller than this are hashed on the calling thread.
+   * */
+  static constexpr std::size_t PARALLEL_THRESHOLD = 4096;
+};
+
+} // namespace snapshot
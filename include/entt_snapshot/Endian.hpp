@@ -0,0 +1,53 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace snapshot {
+
+constexpr bool NATIVE_LITTLE_ENDIAN =
+  std::endian::native == std::endian::little;
+
+/**
+ * Converts between native and little-endian byte order, a no-op on
+ * little-endian hosts.
+ * */
+template<typename T>
+T
+toLittleEndian(T value)
+{
+  static_assert(std::is_integral_v<T> || std::is_enum_v<T>,
+                "Only integral values can be byteswapped");
+
+  if constexpr (NATIVE_LITTLE_ENDIAN || sizeof(T) == 1) {
+    return value;
+  } else if constexpr (sizeof(T) == 2) {
+    return static_cast<T>(__builtin_bswap16(static_cast<std::uint16_t>(value)));
+  } else if constexpr (sizeof(T) == 4) {
+    return static_cast<T>(__builtin_bswap32(static_cast<std::uint32_t>(value)));
+  } else {
+    return static_cast<T>(__builtin_bswap64(static_cast<std::uint64_t>(value)));
+  }
+}
+
+template<typename T>
+T
+fromLittleEndian(T value)
+{
+  return toLittleEndian(value);
+}
+
+/**
+ * Byteswaps whole columns of fixed-width values in place. The loops have no
+ * dependencies between iterations and are vectorized by the compiler.
+ * */
+void
+byteswapColumn(std::uint16_t* data, std::size_t count);
+void
+byteswapColumn(std::uint32_t* data, std::size_t count);
+void
+byteswapColumn(std::uint64_t* data, std::size_t count);
+
+} // namespace snapshot
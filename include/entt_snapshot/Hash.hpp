@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include <entt_snapshot/Endian.hpp>
+#include <entt_snapshot/include_proxy/cereal.hpp>
+
+namespace snapshot {
+
+/**
+ * Fast non-cryptographic 64-bit hash (xxHash64). The result is stable across
+ * platforms, input is always read as little-endian.
+ * */
+std::uint64_t
+hashBytes(void const* data, std::size_t size, std::uint64_t seed = 0);
+
+std::uint64_t
+hashCombine(std::uint64_t seed, std::uint64_t value);
+
+namespace detail {
+
+/**
+ * Canonical encoding of hashed components: cereal's binary encoding in
+ * little-endian byte order, without the header byte of cereal's portable
+ * archives. Appends to a buffer owned by the caller.
+ * */
+class HashOutputArchive
+  : public cereal::OutputArchive<HashOutputArchive,
+                                 cereal::AllowEmptyClassElision>
+{
+public:
+  void saveBinary(void const* data,
+                  std::size_t size,
+                  std::size_t element_size)
+  {
+    auto bytes = static_cast<char const*>(data);
+    if constexpr (NATIVE_LITTLE_ENDIAN) {
+      buffer.append(bytes, size);
+    } else {
+      for (auto i = 0UL; i < size; i += element_size) {
+        for (auto j = element_size; j > 0; --j) {
+          buffer.push_back(bytes[i + j - 1]);
+        }
+      }
+    }
+  }
+
+  explicit HashOutputArchive(std::string& in_buffer)
+    : cereal::OutputArchive<HashOutputArchive,
+                            cereal::AllowEmptyClassElision>(this)
+    , buffer(in_buffer)
+  {}
+
+private:
+  std::string& buffer;
+};
+
+template<class T>
+inline std::enable_if_t<std::is_arithmetic_v<T>>
+CEREAL_SAVE_FUNCTION_NAME(HashOutputArchive& archive, T const& t)
+{
+  archive.saveBinary(std::addressof(t), sizeof(t), sizeof(t));
+}
+
+template<class T>
+inline void
+CEREAL_SERIALIZE_FUNCTION_NAME(HashOutputArchive& archive,
+                               cereal::NameValuePair<T>& t)
+{
+  archive(t.value);
+}
+
+template<class T>
+inline void
+CEREAL_SERIALIZE_FUNCTION_NAME(HashOutputArchive& archive,
+                               cereal::SizeTag<T>& t)
+{
+  archive(t.size);
+}
+
+template<class T>
+inline void
+CEREAL_SAVE_FUNCTION_NAME(HashOutputArchive& archive,
+                          cereal::BinaryData<T> const& data)
+{
+  using Element = std::remove_pointer_t<T>;
+  archive.saveBinary(
+    data.data, static_cast<std::size_t>(data.size), sizeof(Element));
+}
+
+} // namespace detail
+
+/**
+ * Hash of a single component instance, equal on all platforms. Components
+ * are hashed via their canonical encoding, see detail::HashOutputArchive,
+ * integral and enum components directly. Entity identifiers are hashed as
+ * saved, so registries only hash equally if their identifiers match.
+ *
+ * Specialize for types which can be hashed faster, but keep the result
+ * independent of the host, e.g. don't hash raw pointers or padding bytes.
+ * */
+template<typename T, typename = void>
+struct ComponentHash
+{
+  std::uint64_t operator()(T const& comp) const
+  {
+    if constexpr (std::is_empty_v<T>) {
+      return 0;
+    } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+      auto value = toLittleEndian(comp);
+      return hashBytes(&value, sizeof(value));
+    } else {
+      // reused buffer, hashing doesn't allocate in steady state
+      thread_local auto bytes = std::string{};
+      bytes.clear();
+      {
+        auto archive = detail::HashOutputArchive{ bytes };
+        archive(comp);
+      }
+      return hashBytes(bytes.data(), bytes.size());
+    }
+  }
+};
+
+} // namespace snapshot
+
+CEREAL_REGISTER_ARCHIVE(snapshot::detail::HashOutputArchive)
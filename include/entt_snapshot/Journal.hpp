@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Reflection.hpp"
+#include "Snapshot.hpp"
+
+namespace snapshot {
+
+struct JournalOptions
+{
+  /**
+   * Longest time changes are buffered before being committed.
+   * */
+  std::chrono::milliseconds commit_interval{ 10 };
+  /**
+   * Size of the journal from which on compactIfNeeded compacts.
+   * */
+  std::uint64_t compact_size = std::uint64_t{ 64 } << 20;
+};
+
+/**
+ * Write-ahead log of the changes of reflected components. Changes are
+ * encoded when they happen and appended to the journal by a background
+ * thread, which commits all changes of a commit interval at once.
+ *
+ * The journal's directory contains the last full snapshot and the journal
+ * of all changes since. Each journal record is framed by its size and hash,
+ * so a record torn by a crash ends the replay.
+ *
+ * Changes are recorded via the registry's construction, update and
+ * destruction signals. Components modified in place, e.g. via get<T>(),
+ * aren't recorded unless they are patched or replaced. Entities themselves
+ * aren't journaled: a destroyed entity is recorded as the removal of its
+ * components, and replaying destroys an entity as soon as a removal leaves
+ * it without any component, so that its identifier can be recreated.
+ *
+ * Only the thread owning the registry may use the journal.
+ * */
+class Journal : private ChangeListener
+{
+public:
+  static constexpr auto SNAPSHOT_FILE = "snapshot.bin";
+  static constexpr auto JOURNAL_FILE = "journal.bin";
+
+  /**
+   * Blocks until all changes recorded so far are durable.
+   * */
+  void flush();
+
+  /**
+   * Saves a full snapshot and truncates the journal.
+   * */
+  void compact();
+  bool compactIfNeeded();
+
+  /**
+   * Size of the journal since the last compaction, in bytes.
+   * */
+  std::uint64_t size() const;
+
+  /**
+   * Loads the directory's snapshot and replays its journal into reg, which
+   * should be empty. Call before attaching a journal to reg. Returns the
+   * number of replayed changes, throws if a file can't be opened.
+   * */
+  static std::size_t recover(entt::registry& reg,
+                             std::filesystem::path const& directory,
+                             ShouldSerializePred);
+  static std::size_t replay(entt::registry& reg,
+                            std::string_view journal,
+                            ShouldSerializePred const&);
+
+  /**
+   * Records the changes of all reflected components accepted by
+   * should_serialize, starting with a compaction of reg's current state.
+   * */
+  Journal(entt::registry& reg,
+          std::filesystem::path directory,
+          ShouldSerializePred should_serialize,
+          JournalOptions options = JournalOptions{});
+  Journal(Journal const&) = delete;
+  Journal& operator=(Journal const&) = delete;
+  ~Journal();
+
+private:
+  void changed(entt::registry&,
+               entt::entity,
+               ComponentReflection const&,
+               ComponentChange) override;
+
+  void append(std::string const& record);
+  void commitLoop();
+
+private:
+  entt::registry& reg;
+  std::filesystem::path directory;
+  ShouldSerializePred should_serialize;
+  JournalOptions options;
+  std::vector<ComponentReflection> tracked;
+  int fd;
+
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable committed;
+  /**
+   * Framed records not yet handed to the commit thread.
+   * */
+  std::string pending;
+  /**
+   * Bytes appended to and committed to the journal since the last compaction.
+   * */
+  std::uint64_t appended;
+  std::uint64_t durable;
+  std::uint64_t requested;
+  std::exception_ptr error;
+  bool stop;
+  std::thread committer;
+};
+
+} // namespace snapshot
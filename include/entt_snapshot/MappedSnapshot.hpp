@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Reflection.hpp"
+#include "Snapshot.hpp"
+
+namespace snapshot {
+
+namespace detail {
+
+constexpr std::uint64_t MAPPED_MAGIC = 0x50414e5354544e45ULL; // "ENTTSNAP"
+constexpr std::uint64_t MAPPED_FORMAT_VERSION = 2;
+
+/**
+ * Layout of an indexed snapshot:
+ *   component payloads (each encoded by its own little-endian portable
+ *                       binary archive)
+ *   type table        (u32 name-length + name per type)
+ *   entity table      (MappedEntity per entity, sorted by entity)
+ *   component table   (MappedComponent per component, grouped by entity)
+ *   MappedTrailer
+ * All fields are fixed-width little-endian. Tables are 8-byte aligned and
+ * consist of u64 columns only, so on little-endian hosts they are used in
+ * place and on big-endian hosts they are byteswapped as a whole.
+ * */
+struct MappedEntity
+{
+  std::uint64_t e;
+  std::uint64_t first_component;
+  std::uint64_t component_count;
+};
+
+struct MappedComponent
+{
+  std::uint64_t offset;
+  std::uint64_t size;
+  std::uint64_t type;
+};
+
+struct MappedTrailer
+{
+  std::uint64_t magic;
+  std::uint64_t version;
+  std::uint64_t type_count;
+  std::uint64_t types_offset;
+  std::uint64_t entities_offset;
+  std::uint64_t entity_count;
+  std::uint64_t components_offset;
+  std::uint64_t component_count;
+};
+
+} // namespace detail
+
+/**
+ * Writes indexed snapshots which can be opened via SnapshotView. Components
+ * may be written in any order, the index is built by finish.
+ * */
+class MappedSnapshotWriter
+{
+public:
+  void add(entt::entity);
+  void write(entt::entity, Handle const&);
+  void finish();
+
+  MappedSnapshotWriter(std::ostream&);
+
+private:
+  struct Record
+  {
+    entt::entity e;
+    std::uint32_t type;
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+
+  std::uint32_t typeIndex(std::string_view name);
+  void writeBytes(void const* data, std::size_t size);
+  void pad();
+
+private:
+  std::ostream& stream;
+  std::uint64_t offset;
+  std::vector<std::string> types;
+  std::unordered_map<std::string, std::uint32_t> type_indices;
+  std::vector<entt::entity> entities;
+  std::vector<Record> records;
+};
+
+class MappedSnapshot
+{
+public:
+  static void save(std::ostream&, entt::registry const&, ShouldSerializePred);
+};
+
+/**
+ * Read-only view of a memory-mapped indexed snapshot. Opening only reads the
+ * trailer and the type table, components are decoded on first access and
+ * cached. All tables and records are bounds checked, truncated or corrupt
+ * files throw instead of being read out of bounds. Not thread-safe.
+ * */
+class SnapshotView
+{
+public:
+  std::size_t size() const noexcept;
+  entt::entity entity(std::size_t i) const;
+  std::vector<entt::entity> entities() const;
+
+  bool contains(entt::entity) const;
+  bool contains(entt::entity, Reflection const&) const;
+
+  /**
+   * Reflections of all components stored for the entity, except for the ones
+   * not reflected in this process.
+   * */
+  std::vector<Reflection> components(entt::entity) const;
+  /**
+   * Saved names of all components stored for the entity, reflected or not.
+   * */
+  std::vector<std::string_view> componentNames(entt::entity) const;
+
+  /**
+   * Returns a reference to the cached component.
+   * */
+  entt::meta_any get(entt::entity, Reflection const&) const;
+
+  template<typename T>
+  T const& get(entt::entity e) const
+  {
+    auto any = get(e, Reflection{ entt::resolve<T>() });
+    return *static_cast<T const*>(std::as_const(any).data());
+  }
+
+  /**
+   * Drops all decoded components.
+   * */
+  void clearCache();
+
+  SnapshotView(std::filesystem::path const&);
+  SnapshotView(SnapshotView&&) noexcept;
+  SnapshotView& operator=(SnapshotView&&) noexcept;
+  SnapshotView(SnapshotView const&) = delete;
+  SnapshotView& operator=(SnapshotView const&) = delete;
+  ~SnapshotView();
+
+private:
+  detail::MappedEntity const* find(entt::entity) const;
+  detail::MappedComponent const* find(entt::entity, Reflection const&) const;
+
+private:
+  char const* data;
+  std::size_t data_size;
+  detail::MappedTrailer trailer;
+  detail::MappedEntity const* entity_table;
+  detail::MappedComponent const* component_table;
+  /**
+   * Byteswapped copies of the tables, only used on big-endian hosts.
+   * */
+  std::vector<detail::MappedEntity> swapped_entities;
+  std::vector<detail::MappedComponent> swapped_components;
+  /**
+   * Invalid for types not reflected in this process.
+   * */
+  std::vector<Reflection> types;
+  std::vector<std::string> type_names;
+  mutable std::unordered_map<std::uint64_t, entt::meta_any> cache;
+};
+
+} // namespace snapshot
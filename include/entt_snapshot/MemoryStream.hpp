@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace snapshot {
+
+namespace detail {
+
+/**
+ * Read-only streambuf over memory which isn't owned, e.g. a mapped file.
+ * */
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+  MemoryStreamBuf(char const* data, std::size_t size)
+  {
+    auto begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+};
+
+class MemoryInputStream
+  : private MemoryStreamBuf
+  , public std::istream
+{
+public:
+  MemoryInputStream(char const* data, std::size_t size)
+    : MemoryStreamBuf(data, size)
+    , std::istream(static_cast<MemoryStreamBuf*>(this))
+  {}
+};
+
+/**
+ * Streambuf appending to a string which isn't owned, so the string's buffer
+ * can be reused across streams.
+ * */
+class StringStreamBuf : public std::streambuf
+{
+public:
+  explicit StringStreamBuf(std::string& in_out)
+    : out(in_out)
+  {}
+
+protected:
+  int_type overflow(int_type c) override
+  {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      out.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(char const* data, std::streamsize size) override
+  {
+    out.append(data, static_cast<std::size_t>(size));
+    return size;
+  }
+
+private:
+  std::string& out;
+};
+
+class StringOutputStream
+  : private StringStreamBuf
+  , public std::ostream
+{
+public:
+  explicit StringOutputStream(std::string& out)
+    : StringStreamBuf(out)
+    , std::ostream(static_cast<StringStreamBuf*>(this))
+  {}
+};
+
+} // namespace detail
+
+} // namespace snapshot
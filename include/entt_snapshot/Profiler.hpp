@@ -0,0 +1,272 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+namespace snapshot {
+
+enum class ProfileOp : std::uint8_t
+{
+  encode,
+  decode
+};
+
+struct ProfileOptions
+{
+  /**
+   * Number of slowest entities and components kept per operation.
+   * */
+  std::size_t top_k = 16;
+  /**
+   * Every sample_interval-th entity and its components are timed, 1 times
+   * all of them. Sizes are recorded for all entities, since they are known
+   * without measuring.
+   * */
+  std::uint32_t sample_interval = 1;
+};
+
+struct ProfileSample
+{
+  /**
+   * For decoding the saved entity.
+   * */
+  entt::entity e;
+  /**
+   * Empty for samples of whole entities.
+   * */
+  std::string component;
+  std::uint64_t nanoseconds;
+  std::uint64_t bytes;
+};
+
+struct ProfileTotals
+{
+  std::uint64_t count = 0;
+  std::uint64_t bytes = 0;
+  /**
+   * Number of timed instances and their total time.
+   * */
+  std::uint64_t timed = 0;
+  std::uint64_t nanoseconds = 0;
+};
+
+/**
+ * Histogram with power of two buckets, bucket i > 0 counts the values within
+ * [2^(i - 1), 2^i).
+ * */
+class ProfileHistogram
+{
+public:
+  static constexpr auto BUCKETS = 65UL;
+
+  void add(std::uint64_t value);
+  /**
+   * Upper bound of the bucket containing the p-quantile, p within [0, 1].
+   * */
+  std::uint64_t quantile(double p) const;
+
+  std::uint64_t count() const noexcept { return total_count; }
+  std::uint64_t sum() const noexcept { return total; }
+  std::uint64_t max() const noexcept { return maximum; }
+  std::array<std::uint64_t, BUCKETS> const& buckets() const noexcept
+  {
+    return counts;
+  }
+
+private:
+  std::array<std::uint64_t, BUCKETS> counts{};
+  std::uint64_t total_count = 0;
+  std::uint64_t total = 0;
+  std::uint64_t maximum = 0;
+};
+
+namespace detail {
+class ProfileScope;
+} // namespace detail
+
+/**
+ * Measures the time and size of encoding and decoding entities and their
+ * components while it is alive, for saves and loads on the constructing
+ * thread. Keeps histograms of the entities' times and sizes and the slowest
+ * entities and components, so single outliers (e.g. a component holding a
+ * huge container) can be found. Only the timed entities and components, see
+ * ProfileOptions::sample_interval, are kept as slowest ones.
+ *
+ * Without a profiler each entity and component only checks a thread local
+ * pointer. Sizes are only measured for binary archives, where components are
+ * saved as records. Loading only measures the entities and components which
+ * are decoded, skipped ones are neither timed nor counted.
+ *
+ * Profilers of a thread nest, the innermost one measures. They have to be
+ * destroyed on their thread, but may be destroyed in any order.
+ * */
+class Profiler
+{
+public:
+  /**
+   * Profiler of the calling thread, or null.
+   * */
+  static Profiler* active() noexcept { return current; }
+
+  /**
+   * Sorted by descending time.
+   * */
+  std::vector<ProfileSample> slowestEntities(ProfileOp) const;
+  std::vector<ProfileSample> slowestComponents(ProfileOp) const;
+
+  ProfileHistogram const& entityTimes(ProfileOp) const;
+  ProfileHistogram const& entityBytes(ProfileOp) const;
+  std::map<std::string, ProfileTotals, std::less<>> const& componentTotals(
+    ProfileOp) const;
+
+  /**
+   * Human-readable summary of all measurements, e.g. for diagnostics.
+   * */
+  std::string report() const;
+  void reset();
+
+  explicit Profiler(ProfileOptions options = ProfileOptions{});
+  Profiler(Profiler const&) = delete;
+  Profiler& operator=(Profiler const&) = delete;
+  ~Profiler();
+
+private:
+  friend class detail::ProfileScope;
+
+  struct Stats
+  {
+    ProfileHistogram entity_times;
+    ProfileHistogram entity_bytes;
+    /**
+     * Bounded min-heaps by time.
+     * */
+    std::vector<ProfileSample> slowest_entities;
+    std::vector<ProfileSample> slowest_components;
+    std::map<std::string, ProfileTotals, std::less<>> components;
+  };
+
+  /**
+   * nanoseconds is only set for timed scopes.
+   * */
+  void recordEntity(ProfileOp,
+                    std::optional<std::uint64_t> nanoseconds,
+                    std::uint64_t bytes);
+  void recordComponent(ProfileOp,
+                       std::string_view component,
+                       std::optional<std::uint64_t> nanoseconds,
+                       std::uint64_t bytes);
+  void keep(std::vector<ProfileSample>& heap, ProfileSample&& sample) const;
+
+private:
+  static inline thread_local Profiler* current = nullptr;
+
+  ProfileOptions options;
+  std::array<Stats, 2> stats;
+  Profiler* previous;
+
+  /**
+   * State of the entity being encoded or decoded.
+   * */
+  std::uint64_t entity_count;
+  bool measuring;
+  bool timing;
+  entt::entity entity;
+  std::uint64_t bytes;
+};
+
+namespace detail {
+
+/**
+ * Measures an entity or one of its components while alive. Components are
+ * only measured within an entity, and only timed within a sampled one.
+ * */
+class ProfileScope
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  ProfileScope(ProfileOp in_op, entt::entity e)
+    : profiler(Profiler::active())
+    , op(in_op)
+  {
+    if (!profiler) {
+      return;
+    }
+    if (profiler->measuring) {
+      profiler = nullptr;
+      return;
+    }
+    profiler->measuring = true;
+    profiler->timing =
+      profiler->entity_count++ % profiler->options.sample_interval == 0;
+    profiler->entity = e;
+    begin();
+  }
+
+  ProfileScope(ProfileOp in_op, std::string_view in_component)
+    : profiler(Profiler::active())
+    , op(in_op)
+    , component(in_component)
+  {
+    if (!profiler) {
+      return;
+    }
+    if (!profiler->measuring) {
+      profiler = nullptr;
+      return;
+    }
+    begin();
+  }
+
+  /**
+   * Attributes bytes to the measured entity and component.
+   * */
+  static void addBytes(std::size_t count) noexcept
+  {
+    if (auto active = Profiler::active(); active && active->measuring) {
+      active->bytes += count;
+    }
+  }
+
+  ProfileScope(ProfileScope const&) = delete;
+  ProfileScope& operator=(ProfileScope const&) = delete;
+  ~ProfileScope()
+  {
+    if (profiler) {
+      end();
+    }
+  }
+
+private:
+  void begin()
+  {
+    bytes = profiler->bytes;
+    if (profiler->timing) {
+      start = Clock::now();
+    }
+  }
+  void end();
+
+private:
+  Profiler* profiler;
+  ProfileOp op;
+  /**
+   * Empty for entities.
+   * */
+  std::string_view component;
+  Clock::time_point start;
+  std::uint64_t bytes = 0;
+};
+
+} // namespace detail
+
+} // namespace snapshot
@@ -1,8 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
 #include <entt/entt.hpp>
 
 #include "Archive.hpp"
+#include "Hash.hpp"
+#include "MemoryStream.hpp"
+#include "Profiler.hpp"
+#include "StorageCopy.hpp"
 
 namespace snapshot {
 
@@ -15,6 +32,30 @@ constexpr auto REMOVE_COMPONENT_FN_NAME = entt::hashed_string{ "remove" };
 constexpr auto GET_CONST_COMPONENT_FN_NAME = entt::hashed_string{ "get_const" };
 constexpr auto GET_COMPONENT_FN_NAME = entt::hashed_string{ "get" };
 constexpr auto EMPLACE_COMPONENT_FN_NAME = entt::hashed_string{ "emplace" };
+constexpr auto EMPLACE_SILENT_COMPONENT_FN_NAME =
+  entt::hashed_string{ "emplace_silent" };
+constexpr auto HAS_LISTENERS_FN_NAME = entt::hashed_string{ "has_listeners" };
+constexpr auto IS_TAG_FN_NAME = entt::hashed_string{ "is_tag" };
+constexpr auto INSERT_TAGS_FN_NAME = entt::hashed_string{ "insert_tags" };
+constexpr auto HASH_STORAGE_FN_NAME = entt::hashed_string{ "hash_storage" };
+constexpr auto SORT_AS_FN_NAME = entt::hashed_string{ "sort_as" };
+constexpr auto SORT_LIKE_FN_NAME = entt::hashed_string{ "sort_like" };
+constexpr auto VERSION_FN_NAME = entt::hashed_string{ "version" };
+constexpr auto MIGRATE_FN_NAME = entt::hashed_string{ "migrate" };
+constexpr auto HAS_ENTITY_REFS_FN_NAME =
+  entt::hashed_string{ "has_entity_refs" };
+constexpr auto COLLECT_ENTITY_REFS_FN_NAME =
+  entt::hashed_string{ "collect_entity_refs" };
+constexpr auto REMAP_ENTITY_REFS_FN_NAME =
+  entt::hashed_string{ "remap_entity_refs" };
+constexpr auto CONNECT_CHANGES_FN_NAME =
+  entt::hashed_string{ "connect_changes" };
+constexpr auto DISCONNECT_CHANGES_FN_NAME =
+  entt::hashed_string{ "disconnect_changes" };
+constexpr auto MAKE_STORAGE_COPY_FN_NAME =
+  entt::hashed_string{ "make_storage_copy" };
+constexpr auto MIGRATE_STORAGE_FN_NAME =
+  entt::hashed_string{ "migrate_storage" };
 
 class Reflection
 {
@@ -35,6 +76,31 @@ private:
   entt::meta_type _type;
 };
 
+class ComponentReflection;
+
+enum class ComponentChange : std::uint8_t
+{
+  update,
+  remove
+};
+
+/**
+ * Receives the changes of reflected components, see
+ * ComponentReflection::connectChanges. Construction is reported as update,
+ * removal is reported before the component is removed.
+ * */
+class ChangeListener
+{
+public:
+  virtual void changed(entt::registry&,
+                       entt::entity,
+                       ComponentReflection const&,
+                       ComponentChange) = 0;
+
+protected:
+  ~ChangeListener() = default;
+};
+
 class ComponentReflection
 {
 public:
@@ -47,6 +113,98 @@ public:
   void remove(entt::handle) const;
   void emplace(entt::handle, entt::meta_handle comp) const;
   void emplace(entt::handle) const;
+  /**
+   * Like emplace, but without publishing construction or update signals.
+   * Only valid while the storage has no listeners, see hasListeners, since
+   * groups and observers would miss the instance otherwise.
+   * */
+  void emplaceSilent(entt::handle, entt::meta_handle comp) const;
+
+  /**
+   * Whether anything, e.g. a group or an observer, listens to the
+   * construction or update of the component in reg.
+   * */
+  bool hasListeners(entt::registry& reg) const;
+
+  /**
+   * Whether the component is an empty type. Registries save tags as sets of
+   * entities instead of per-instance records.
+   * */
+  bool isTag() const;
+
+  /**
+   * Adds the tag to all passed entities at once, silent omits the
+   * construction signals like emplaceSilent.
+   * */
+  void insertTags(entt::registry& reg,
+                  std::vector<entt::entity> const& entities,
+                  bool silent) const;
+
+  /**
+   * Order-independent hash over all instances of the component in reg.
+   * */
+  std::uint64_t hash(entt::registry const& reg) const;
+
+  /**
+   * Sorts the component's storage so that its packed array equals order.
+   * Entities missing in order are moved behind the others.
+   * */
+  void sortAs(entt::registry& reg,
+              std::vector<entt::entity> const& order) const;
+
+  /**
+   * Sorts the component's storage like other, see
+   * entt::basic_sparse_set::respect.
+   * */
+  void sortLike(entt::registry& reg,
+                entt::basic_sparse_set<entt::entity> const& other) const;
+
+  /**
+   * Version passed to reflectComponent.
+   * */
+  std::uint32_t version() const;
+
+  /**
+   * Applies the registered migrations from version from up to the reflected
+   * version to the passed instances of the component. Throws if a migration
+   * is missing.
+   * */
+  void migrate(std::uint32_t from, std::vector<void*> const& instances) const;
+  void migrate(entt::registry& reg,
+               std::uint32_t from,
+               std::vector<entt::entity> const& entities) const;
+
+  /**
+   * Whether entity references were registered for the component.
+   * */
+  bool hasEntityRefs() const;
+
+  /**
+   * Appends the entities referenced by comp to out.
+   * */
+  void collectEntityRefs(entt::meta_handle comp,
+                         std::vector<entt::entity>& out) const;
+
+  /**
+   * Replaces the references held by the passed instances of the component
+   * via mapping, references missing in mapping become null.
+   * */
+  void remapEntityRefs(
+    std::vector<void*> const& instances,
+    std::unordered_map<entt::entity, entt::entity> const& mapping) const;
+
+  /**
+   * Connects listener to the construction, update and destruction signals of
+   * the component's storage in reg.
+   * */
+  void connectChanges(entt::registry& reg, ChangeListener& listener) const;
+  void disconnectChanges(entt::registry& reg, ChangeListener& listener) const;
+
+  /**
+   * Empty copy of the component's storage, see RollbackBuffer. Null for
+   * components which aren't copy constructible.
+   * */
+  std::unique_ptr<detail::StorageCopy> makeStorageCopy() const;
 
   inline operator bool() const noexcept { return _reflection.operator bool(); }
 
@@ -58,6 +216,107 @@ private:
   Reflection _reflection;
 };
 
+namespace detail {
+
+/**
+ * Binary archives prefix each component with the size of its encoding, thus
+ * readers can skip components without decoding them. Each record is encoded
+ * by its own archive.
+ * */
+template<typename Archive>
+constexpr bool HAS_RECORDS = !cereal::traits::is_text_archive<Archive>::value;
+
+/**
+ * Portable archives start with a byte flagging their endianness. Records are
+ * always little endian, so the flag is left out and restored when reading.
+ * */
+template<typename Archive>
+constexpr std::size_t RECORD_HEADER_SIZE =
+  std::is_same_v<Archive, cereal::PortableBinaryOutputArchive> ||
+      std::is_same_v<Archive, cereal::PortableBinaryInputArchive>
+    ? 1
+    : 0;
+
+/**
+ * Writes the encoding of encode, which is passed an archive of the same type
+ * as archive, as record.
+ * */
+template<typename Archive, typename Func>
+void
+saveRecord(Archive& archive, Func&& encode)
+{
+  using PortableArchive = cereal::PortableBinaryOutputArchive;
+  if constexpr (std::is_same_v<Archive, BufferOutputArchive>) {
+    // encoded in place
+    auto position = archive.size();
+    archive.saveRecord(std::forward<Func>(encode));
+    ProfileScope::addBytes(archive.size() - position);
+  } else {
+    // cereal's archives don't expose their stream to patch the size in, the
+    // record is encoded into a reused buffer instead; records nested within a
+    // record find the buffer taken and use their own
+    thread_local auto buffer = std::string{};
+    auto bytes = std::move(buffer);
+    bytes.clear();
+    {
+      auto stream = StringOutputStream{ bytes };
+      if constexpr (std::is_same_v<Archive, PortableArchive>) {
+        auto record = Archive{ stream, Archive::Options::LittleEndian() };
+        encode(record);
+      } else {
+        auto record = Archive{ stream };
+        encode(record);
+      }
+    }
+
+    constexpr auto header = RECORD_HEADER_SIZE<Archive>;
+    auto size = static_cast<cereal::size_type>(bytes.size() - header);
+    archive(cereal::make_size_tag(size));
+    archive(cereal::binary_data(bytes.data() + header, size));
+    ProfileScope::addBytes(sizeof(size) + size);
+    buffer = std::move(bytes);
+  }
+}
+
+/**
+ * Reads the next record. If decode is set, func is passed an archive of the
+ * same type as archive over the record, otherwise the record is skipped.
+ * */
+template<typename Archive, typename Func>
+void
+loadRecord(Archive& archive, bool decode, Func&& func)
+{
+  if constexpr (std::is_same_v<Archive, BufferInputArchive>) {
+    auto position = archive.size();
+    archive.loadRecord(decode, std::forward<Func>(func));
+    if (decode) {
+      ProfileScope::addBytes(archive.size() - position);
+    }
+  } else {
+    // reused buffer, stream archives have to read skipped records as well
+    thread_local auto bytes = std::string{};
+
+    // the little endian flag left out by saveRecord
+    constexpr auto header = RECORD_HEADER_SIZE<Archive>;
+    auto size = cereal::size_type{ 0 };
+    archive(cereal::make_size_tag(size));
+    bytes.resize(header + size);
+    if constexpr (header != 0) {
+      bytes[0] = 1;
+    }
+    archive(cereal::binary_data(bytes.data() + header, size));
+
+    if (decode) {
+      ProfileScope::addBytes(sizeof(size) + size);
+      auto stream = MemoryInputStream{ bytes.data(), bytes.size() };
+      auto record = Archive{ stream };
+      func(record);
+    }
+  }
+}
+
+} // namespace detail
+
 class Handle
 {
 public:
@@ -81,6 +340,11 @@ public:
   entt::meta_handle const& operator*() const { return any; }
   entt::meta_handle& operator*() { return any; }
 
+  /**
+   * Serializes only the component, without the type-information.
+   * */
+  void doSave(OutputArchive archive) const;
+
   Handle() = default;
   Handle(entt::meta_any const&);
 
@@ -94,7 +358,14 @@ private:
       auto temp_name = std::string{ reflection().name().data() };
 
       archive(cereal::make_nvp("type", temp_name));
-      doSave(archive);
+
+      auto scope = detail::ProfileScope{ ProfileOp::encode, temp_name };
+      if constexpr (detail::HAS_RECORDS<Archive>) {
+        detail::saveRecord(archive,
+                           [this](Archive& record) { doSave(record); });
+      } else {
+        doSave(archive);
+      }
     } else {
       archive(cereal::make_nvp("has_any", false));
     }
@@ -105,8 +376,6 @@ private:
     throw std::runtime_error("Don't load via handle");
   }
 
-  void doSave(OutputArchive archive) const;
-
 private:
   entt::meta_handle any;
 };
@@ -136,6 +405,50 @@ public:
   entt::meta_any const& operator*() const { return any; }
   entt::meta_any& operator*() { return any; }
 
+  /**
+   * Deserializes only the component into the already constructed any.
+   * */
+  void doLoad(InputArchive archive);
+
+  /**
+   * Like loading via cereal, but only constructs and decodes the component if
+   * pred accepts its name. Otherwise this stays empty and, for binary
+   * archives, the component's record is skipped undecoded.
+   * */
+  template<typename Archive, typename Pred>
+  void loadIf(Archive& archive, Pred&& pred)
+  {
+    auto has_any = false;
+    archive(has_any);
+    if (!has_any) {
+      return;
+    }
+
+    auto name = std::string{};
+    archive(name);
+
+    // skipped components aren't measured
+    auto accepted = pred(name.c_str());
+    auto scope = std::optional<detail::ProfileScope>{};
+    if (accepted) {
+      scope.emplace(ProfileOp::decode, name);
+    }
+
+    if constexpr (detail::HAS_RECORDS<Archive>) {
+      detail::loadRecord(archive, accepted, [this, &name](Archive& record) {
+        construct(name);
+        doLoad(record);
+      });
+    } else {
+      // text archives don't have records which could be skipped
+      construct(name);
+      doLoad(archive);
+      if (!accepted) {
+        any = entt::meta_any{};
+      }
+    }
+  }
+
   Any() = default;
   Any(entt::meta_any);
 
@@ -149,27 +462,66 @@ private:
   template<typename Archive>
   void load(Archive& archive)
   {
-    auto has_any = false;
-    archive(has_any);
-    if (has_any) {
-      auto name = std::string{};
-      archive(name);
-      auto refl = Reflection{ name };
-      any = refl.type().construct();
-      if (!any) {
-        throw std::runtime_error("Failed to construct any");
-      }
-
-      doLoad(archive);
-    }
+    loadIf(archive, [](char const*) { return true; });
   }
 
-  void doLoad(InputArchive archive);
+  void construct(std::string const& name);
 
 private:
   entt::meta_any any;
 };
 
+/**
+ * Upgrades a batch of component instances, which were saved with version N,
+ * to version N + 1. Layout changes are decoded via cereal's class versioning,
+ * migrations then fix up the decoded values.
+ * */
+template<typename T>
+using Migration = std::function<void(std::span<T* const>)>;
+
+namespace detail {
+
+template<typename T>
+std::map<std::uint32_t, Migration<T>>&
+migrations()
+{
+  static auto res = std::map<std::uint32_t, Migration<T>>{};
+  return res;
+}
+
+using EntityMapping = std::unordered_map<entt::entity, entt::entity>;
+
+/**
+ * Accessors of a member holding entity references. The member is identified
+ * by its type and offset, since the accessors' addresses may differ between
+ * shared objects or be folded with identical ones.
+ * */
+template<typename T>
+struct EntityRefField
+{
+  entt::id_type type;
+  std::size_t offset;
+  void (*collect)(T const&, std::vector<entt::entity>&);
+  void (*remap)(T&, EntityMapping const&);
+};
+
+template<typename T>
+std::vector<EntityRefField<T>>&
+entityRefs()
+{
+  static auto res = std::vector<EntityRefField<T>>{};
+  return res;
+}
+
+inline entt::entity
+remapEntity(entt::entity e, EntityMapping const& mapping)
+{
+  auto it = mapping.find(e);
+  return it != mapping.end() ? it->second : entt::entity{ entt::null };
+}
+
+} // namespace detail
+
 /**
  * Collection of functions to be reflected for components.
  * */
@@ -180,8 +532,17 @@ void
 doLoad(void* data, InputArchive archive)
 {
   auto& comp = *static_cast<T*>(data);
-  auto name = Reflection{ entt::resolve<T>() }.name();
 
+  // trivially copyable components have a fixed size encoding
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    if (auto buffer = archive.bufferArchive()) {
+      thread_local auto encoded_size = std::size_t{ 0 };
+      buffer->loadFixed(comp, encoded_size);
+      return;
+    }
+  }
+
+  auto name = Reflection{ entt::resolve<T>() }.name();
   archive(cereal::make_nvp(std::string{ name.data() }, comp));
 }
 
@@ -203,6 +564,37 @@ doEmplace(entt::handle handle, void* data)
   handle.emplace_or_replace<T>(std::move(comp));
 }
 
+template<typename T>
+void
+doEmplaceSilent(entt::handle handle, void* data)
+{
+  // the registry's storage publishes signals, its base doesn't
+  auto& storage = static_cast<entt::basic_storage<entt::entity, T>&>(
+    handle.registry()->template storage<T>());
+  auto e = handle.entity();
+
+  if constexpr (std::is_empty_v<T>) {
+    if (!storage.contains(e)) {
+      storage.emplace(e);
+    }
+  } else {
+    auto& comp = *static_cast<T*>(data);
+    if (storage.contains(e)) {
+      storage.get(e) = std::move(comp);
+    } else {
+      storage.emplace(e, std::move(comp));
+    }
+  }
+}
+
+template<typename T>
+bool
+doHasListeners(entt::registry* reg)
+{
+  return !reg->template on_construct<T>().empty() ||
+         !reg->template on_update<T>().empty();
+}
+
 template<typename T>
 void
 doRemove(entt::handle h)
@@ -223,24 +615,257 @@ template<typename T>
 T&
 doGetComponent(entt::handle h)
 {
-  auto* v = h.template try_get<T>();
-  if (v) {
-    return *v;
+  if constexpr (std::is_empty_v<T>) {
+    // storages of empty types don't hold instances
+    static auto instance = T{};
+    if (h.all_of<T>()) {
+      return instance;
+    }
   } else {
-    throw std::runtime_error("doGetComponent: can't get component");
+    auto* v = h.template try_get<T>();
+    if (v) {
+      return *v;
+    }
   }
+  throw std::runtime_error("doGetComponent: can't get component");
 }
 
 template<typename T>
 T const&
 doGetConstComponent(entt::const_handle h)
 {
-  auto* v = h.template try_get<T>();
-  if (v) {
-    return *v;
+  if constexpr (std::is_empty_v<T>) {
+    static auto const instance = T{};
+    if (h.all_of<T>()) {
+      return instance;
+    }
   } else {
-    throw std::runtime_error("doGetConstComponent: can't get component");
+    auto* v = h.template try_get<T>();
+    if (v) {
+      return *v;
+    }
   }
+  throw std::runtime_error("doGetConstComponent: can't get component");
+}
+
+template<typename T>
+bool
+doIsTag()
+{
+  return std::is_empty_v<T>;
+}
+
+template<typename T>
+void
+doInsertTags(entt::registry* reg,
+             std::vector<entt::entity> const* entities,
+             bool silent)
+{
+  if constexpr (std::is_empty_v<T>) {
+    auto& storage = reg->template storage<T>();
+
+    auto missing = std::vector<entt::entity>{};
+    missing.reserve(entities->size());
+    std::copy_if(entities->begin(),
+                 entities->end(),
+                 std::back_inserter(missing),
+                 [&storage](entt::entity e) { return !storage.contains(e); });
+
+    if (silent) {
+      static_cast<entt::basic_storage<entt::entity, T>&>(storage).insert(
+        missing.begin(), missing.end());
+    } else {
+      reg->template insert<T>(missing.begin(), missing.end());
+    }
+  } else {
+    throw std::runtime_error("doInsertTags: component isn't a tag");
+  }
+}
+
+template<typename T>
+std::uint64_t
+doHashStorage(entt::registry const* reg)
+{
+  auto hasher = ComponentHash<T>{};
+  auto res = std::uint64_t{ 0 };
+
+  for (auto e : reg->view<T const>()) {
+    auto comp_hash = std::uint64_t{ 0 };
+    if constexpr (!std::is_empty_v<T>) {
+      comp_hash = hasher(reg->get<T>(e));
+    }
+    // summing keeps the result independent of the storage's order
+    res += hashCombine(static_cast<std::uint64_t>(entt::to_integral(e)),
+                       comp_hash);
+  }
+
+  return res;
+}
+
+template<typename T>
+void
+doSortAs(entt::registry* reg, std::vector<entt::entity> const* order)
+{
+  if (!reg->sortable<T>()) {
+    return;
+  }
+
+  // like entt's respect, each saved entity is swapped into its position,
+  // entities missing in order end up behind the ordered ones
+  auto& storage = reg->storage<T>();
+  auto pos = 0UL;
+  for (auto e : *order) {
+    if (!storage.contains(e)) {
+      continue;
+    }
+    if (storage.index(e) != pos) {
+      storage.swap_elements(storage.data()[pos], e);
+    }
+    ++pos;
+  }
+}
+
+template<typename T>
+void
+doSortLike(entt::registry* reg,
+           entt::basic_sparse_set<entt::entity> const* other)
+{
+  if (reg->sortable<T>()) {
+    reg->storage<T>().respect(*other);
+  }
+}
+
+/**
+ * Applies the steps from version from up to version to, throws without
+ * migrating anything if a step is missing.
+ * */
+template<typename T>
+void
+migrateInstances(std::map<std::uint32_t, Migration<T>> const& steps,
+                 std::uint32_t from,
+                 std::uint32_t to,
+                 std::span<T* const> comps)
+{
+  for (auto version = from; version < to; ++version) {
+    if (!steps.contains(version)) {
+      throw std::runtime_error("Missing migration from version " +
+                               std::to_string(version));
+    }
+  }
+  for (auto version = from; version < to; ++version) {
+    steps.at(version)(comps);
+  }
+}
+
+template<typename T>
+void
+doMigrate(std::uint32_t from,
+          std::uint32_t to,
+          std::vector<void*> const* instances)
+{
+  auto comps = std::vector<T*>{};
+  comps.reserve(instances->size());
+  for (auto instance : *instances) {
+    comps.push_back(static_cast<T*>(instance));
+  }
+
+  migrateInstances<T>(detail::migrations<T>(), from, to, comps);
+}
+
+template<typename T>
+void
+doMigrateStorage(entt::registry* reg,
+                 std::uint32_t from,
+                 std::uint32_t to,
+                 std::vector<entt::entity> const* entities)
+{
+  if constexpr (!std::is_empty_v<T>) {
+    auto comps = std::vector<T*>{};
+    comps.reserve(entities->size());
+    for (auto e : *entities) {
+      comps.push_back(&reg->get<T>(e));
+    }
+
+    migrateInstances<T>(detail::migrations<T>(), from, to, comps);
+  }
+}
+
+template<typename T>
+bool
+doHasEntityRefs()
+{
+  return !detail::entityRefs<T>().empty();
+}
+
+template<typename T>
+void
+doCollectEntityRefs(void const* data, std::vector<entt::entity>* out)
+{
+  auto const& comp = *static_cast<T const*>(data);
+  for (auto const& field : detail::entityRefs<T>()) {
+    field.collect(comp, *out);
+  }
+}
+
+template<typename T>
+void
+doRemapInstances(std::vector<void*> const* instances,
+                 detail::EntityMapping const* mapping)
+{
+  auto const& fields = detail::entityRefs<T>();
+  for (auto instance : *instances) {
+    auto& comp = *static_cast<T*>(instance);
+    for (auto const& field : fields) {
+      field.remap(comp, *mapping);
+    }
+  }
+}
+
+template<typename T, ComponentChange Change>
+void
+notifyChange(ChangeListener& listener, entt::registry& reg, entt::entity e)
+{
+  listener.changed(
+    reg, e, ComponentReflection{ Reflection{ entt::resolve<T>() } }, Change);
+}
+
+template<typename T>
+void
+doConnectChanges(entt::registry* reg, ChangeListener* listener)
+{
+  constexpr auto update = &notifyChange<T, ComponentChange::update>;
+  constexpr auto remove = &notifyChange<T, ComponentChange::remove>;
+
+  reg->on_construct<T>().template connect<update>(*listener);
+  reg->on_update<T>().template connect<update>(*listener);
+  reg->on_destroy<T>().template connect<remove>(*listener);
+}
+
+template<typename T>
+void
+doDisconnectChanges(entt::registry* reg, ChangeListener* listener)
+{
+  reg->on_construct<T>().disconnect(*listener);
+  reg->on_update<T>().disconnect(*listener);
+  reg->on_destroy<T>().disconnect(*listener);
+}
+
+template<typename T>
+detail::StorageCopy*
+doMakeStorageCopy()
+{
+  if constexpr (std::is_copy_constructible_v<T>) {
+    return new detail::TypedStorageCopy<T>{};
+  } else {
+    return nullptr;
+  }
+}
+
+template<typename T, std::uint32_t Version>
+std::uint32_t
+doGetVersion()
+{
+  return Version;
 }
 
 template<typename T>
@@ -255,6 +880,9 @@ void
 reflectComponentFunctions()
 {
   entt::meta<T>().template func<&doEmplace<T>>(EMPLACE_COMPONENT_FN_NAME);
+  entt::meta<T>().template func<&doEmplaceSilent<T>>(
+    EMPLACE_SILENT_COMPONENT_FN_NAME);
+  entt::meta<T>().template func<&doHasListeners<T>>(HAS_LISTENERS_FN_NAME);
   entt::meta<T>().template func<&doRemove<T>>(REMOVE_COMPONENT_FN_NAME);
   entt::meta<T>().template func<&doLoad<T>>(LOAD_FN_NAME);
   entt::meta<T>().template func<&doSave<T>>(SAVE_FN_NAME);
@@ -264,6 +892,24 @@ reflectComponentFunctions()
   entt::meta<T>().template func<&doGetConstComponent<T>, entt::as_cref_t>(
     GET_CONST_COMPONENT_FN_NAME);
   entt::meta<T>().template func<&doGetType<T>>(TYPE_FN_NAME);
+  entt::meta<T>().template func<&doIsTag<T>>(IS_TAG_FN_NAME);
+  entt::meta<T>().template func<&doInsertTags<T>>(INSERT_TAGS_FN_NAME);
+  entt::meta<T>().template func<&doHashStorage<T>>(HASH_STORAGE_FN_NAME);
+  entt::meta<T>().template func<&doSortAs<T>>(SORT_AS_FN_NAME);
+  entt::meta<T>().template func<&doSortLike<T>>(SORT_LIKE_FN_NAME);
+  entt::meta<T>().template func<&doMigrate<T>>(MIGRATE_FN_NAME);
+  entt::meta<T>().template func<&doMigrateStorage<T>>(
+    MIGRATE_STORAGE_FN_NAME);
+  entt::meta<T>().template func<&doHasEntityRefs<T>>(HAS_ENTITY_REFS_FN_NAME);
+  entt::meta<T>().template func<&doCollectEntityRefs<T>>(
+    COLLECT_ENTITY_REFS_FN_NAME);
+  entt::meta<T>().template func<&doRemapInstances<T>>(
+    REMAP_ENTITY_REFS_FN_NAME);
+  entt::meta<T>().template func<&doConnectChanges<T>>(CONNECT_CHANGES_FN_NAME);
+  entt::meta<T>().template func<&doMakeStorageCopy<T>>(
+    MAKE_STORAGE_COPY_FN_NAME);
+  entt::meta<T>().template func<&doDisconnectChanges<T>>(
+    DISCONNECT_CHANGES_FN_NAME);
 }
 
 template<typename T, std::string_view const& Str>
@@ -286,16 +932,107 @@ reflectWithName()
 } // namespace ReflectionFunctions
 
 /**
- * Reflects serialization, emplace, removal, contains, get, get-type for passed
- * component type.
+ * Reflects serialization, emplace, removal, contains, get, get-type,
+ * storage-hashing and storage-sorting for passed component type.
+ * Snapshots record the version, when loading older versions the registered
+ * migrations are applied.
  * */
-template<typename T, std::string_view const& Str>
+template<typename T, std::string_view const& Str, std::uint32_t Version = 0>
 void
 reflectComponent()
 {
   using namespace ReflectionFunctions;
   reflectWithName<T, Str>();
   reflectComponentFunctions<T>();
+  entt::meta<T>().template func<&doGetVersion<T, Version>>(VERSION_FN_NAME);
+}
+
+/**
+ * Registers the migration of component T from version from to from + 1.
+ * */
+template<typename T>
+void
+registerMigration(std::uint32_t from, Migration<T> migration)
+{
+  detail::migrations<T>()[from] = std::move(migration);
+}
+
+namespace detail {
+
+/**
+ * Like offsetof, but for member pointers.
+ * */
+template<typename T, auto Member>
+std::size_t
+memberOffset()
+{
+  alignas(T) std::byte storage[sizeof(T)];
+  auto object = reinterpret_cast<T const*>(storage);
+  auto member = reinterpret_cast<std::byte const*>(&(object->*Member));
+  return static_cast<std::size_t>(member - storage);
+}
+
+template<typename T, auto Member>
+EntityRefField<T>
+makeEntityRefField()
+{
+  using Field = std::remove_cvref_t<decltype(std::declval<T&>().*Member)>;
+
+  return EntityRefField<T>{
+    .type = entt::type_hash<Field>::value(),
+    .offset = memberOffset<T, Member>(),
+    .collect =
+      [](T const& comp, std::vector<entt::entity>& out) {
+        if constexpr (std::is_same_v<Field, entt::entity>) {
+          out.push_back(comp.*Member);
+        } else {
+          out.insert(out.end(), (comp.*Member).begin(), (comp.*Member).end());
+        }
+      },
+    .remap =
+      [](T& comp, EntityMapping const& mapping) {
+        if constexpr (std::is_same_v<Field, entt::entity>) {
+          comp.*Member = remapEntity(comp.*Member, mapping);
+        } else {
+          for (auto& e : comp.*Member) {
+            e = remapEntity(e, mapping);
+          }
+        }
+      }
+  };
+}
+
+/**
+ * Adds the field of Member unless it's already contained, fields of the same
+ * member share their accessors.
+ * */
+template<typename T, auto Member>
+void
+addEntityRefField(std::vector<EntityRefField<T>>& fields)
+{
+  auto field = makeEntityRefField<T, Member>();
+  auto contained = std::any_of(
+    fields.begin(), fields.end(), [&field](EntityRefField<T> const& other) {
+      return other.type == field.type && other.offset == field.offset;
+    });
+  if (!contained) {
+    fields.push_back(field);
+  }
+}
+
+} // namespace detail
+
+/**
+ * Marks Member of component T, either an entt::entity or a container of
+ * them, as reference to other entities. Referenced entities are saved along
+ * with their referrers and references are remapped when loading registries.
+ * Registering a member again has no effect.
+ * */
+template<typename T, auto Member>
+void
+registerEntityRef()
+{
+  detail::addEntityRefField<T, Member>(detail::entityRefs<T>());
 }
 
-} // namespace snapshot
\ No newline at end of file
+} // namespace snapshot
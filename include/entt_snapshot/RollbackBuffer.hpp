@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "Reflection.hpp"
+#include "Snapshot.hpp"
+#include "StorageCopy.hpp"
+
+namespace snapshot {
+
+/**
+ * Ring buffer of in-memory copies of the last frames of a registry, e.g. for
+ * rollback netcode. Frames copy the reflected components accepted by
+ * should_serialize and the entity pool, nothing is serialized.
+ *
+ * Storages which didn't change since the previous frame aren't copied again,
+ * the frames share the previous copy instead. By default changes are detected
+ * by comparing each storage bytewise on every capture and restore, which
+ * costs a pass over all tracked components; components which can't be
+ * compared bytewise are copied every frame. Observing the registry replaces
+ * the comparison by the storages' signals. Slots and their buffers are
+ * reused, so steady state captures don't allocate.
+ * */
+class RollbackBuffer : private ChangeListener
+{
+public:
+  /**
+   * Copies reg as frame, evicting the oldest frame once the buffer is full.
+   * Frames have to increase.
+   * */
+  void capture(entt::registry const& reg, std::uint64_t frame);
+
+  /**
+   * Resets reg to frame and drops all newer frames. Only storages which
+   * differ from the frame are restored. If the entity pool changed since,
+   * entities created since are destroyed and destroyed ones are recreated
+   * with their identifiers, other entities keep their untracked components.
+   * The free list is restored as well, so entities are created in the same
+   * order as after the frame.
+   * */
+  void restore(entt::registry& reg, std::uint64_t frame);
+
+  /**
+   * Tracks changes of reg through the construction, update and destruction
+   * signals of the tracked components, so that only changed storages are
+   * copied or restored and nothing is compared bytewise. Components modified
+   * in place, without patch or replace, have to be reported via markDirty.
+   * Once observing, captures and restores only accept reg, which has to
+   * outlive the buffer.
+   * */
+  void observe(entt::registry& reg);
+
+  /**
+   * Reports an in-place modification of T to an observing buffer.
+   * */
+  template<typename T>
+  void markDirty()
+  {
+    markDirty(entt::resolve<T>().id());
+  }
+  void markDirty(entt::id_type type);
+
+  bool contains(std::uint64_t frame) const;
+  std::size_t size() const noexcept { return count; }
+  std::size_t capacity() const noexcept { return slots.size(); }
+
+  RollbackBuffer(std::size_t capacity, ShouldSerializePred should_serialize);
+  RollbackBuffer(RollbackBuffer const&) = delete;
+  RollbackBuffer& operator=(RollbackBuffer const&) = delete;
+  ~RollbackBuffer();
+
+private:
+  struct Slot
+  {
+    std::uint64_t frame;
+    std::vector<entt::entity> entities;
+    entt::entity released;
+    /**
+     * Copy per tracked component, only valid where the slot owns it.
+     * */
+    std::vector<std::unique_ptr<detail::StorageCopy>> storages;
+    /**
+     * Slot holding the copy of each tracked component.
+     * */
+    std::vector<std::size_t> owners;
+  };
+
+  void changed(entt::registry&,
+               entt::entity,
+               ComponentReflection const&,
+               ComponentChange) override;
+
+  bool changedSince(entt::registry const& reg,
+                    Slot const& slot,
+                    std::size_t i) const;
+  static void restoreEntities(entt::registry& reg, Slot const& slot);
+  std::size_t slotIndex(std::size_t position) const;
+  std::size_t position(std::uint64_t frame) const;
+  void evict();
+
+private:
+  std::vector<ComponentReflection> tracked;
+  std::vector<Slot> slots;
+  entt::registry* observed;
+  /**
+   * Index in tracked per component type, and whether the storage changed
+   * since the last capture or restore, only used while observing.
+   * */
+  std::unordered_map<entt::id_type, std::size_t> indices;
+  std::vector<bool> dirty;
+  std::size_t first;
+  std::size_t count;
+};
+
+} // namespace snapshot
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Archive.hpp"
+#include "Reflection.hpp"
+
+namespace snapshot {
+
+namespace detail {
+
+/**
+ * Saved type table entry, records refer to types by their index.
+ * */
+struct SchemaType
+{
+  std::string name;
+  std::uint32_t version;
+
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(name), CEREAL_NVP(version));
+  }
+};
+
+/**
+ * Packed order of a storage at the time of saving, by type table index.
+ * */
+struct SchemaOrder
+{
+  std::uint32_t index;
+  std::vector<std::uint64_t> entities;
+
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(index), CEREAL_NVP(entities));
+  }
+};
+
+/**
+ * Components of a schema snapshot which have to be migrated or remapped. They
+ * are decoded into a buffer and only emplaced once fixed up, so construction
+ * listeners observe their final values.
+ * */
+class SchemaPending
+{
+public:
+  virtual void load(entt::entity e, InputArchive archive) = 0;
+  /**
+   * Remaps the buffered components via mapping, migrates them and emplaces
+   * them into reg.
+   * */
+  virtual void emplace(entt::registry& reg, EntityMapping const& mapping) = 0;
+
+  virtual ~SchemaPending() = default;
+};
+
+/**
+ * Migrations and entity references of a component, local to its schema.
+ * */
+class SchemaComponent
+{
+public:
+  virtual bool hasEntityRefs() const = 0;
+  virtual std::unique_ptr<SchemaPending> makePending(
+    std::uint32_t from,
+    std::uint32_t to) const = 0;
+
+  virtual ~SchemaComponent() = default;
+};
+
+template<typename T>
+class TypedSchemaComponent : public SchemaComponent
+{
+public:
+  bool hasEntityRefs() const override { return !entity_refs.empty(); }
+  std::unique_ptr<SchemaPending> makePending(std::uint32_t from,
+                                             std::uint32_t to) const override;
+
+  std::map<std::uint32_t, Migration<T>> migrations;
+  std::vector<EntityRefField<T>> entity_refs;
+};
+
+template<typename T>
+class TypedSchemaPending : public SchemaPending
+{
+public:
+  void load(entt::entity e, InputArchive archive) override
+  {
+    entities.push_back(e);
+    archive(instances.emplace_back());
+  }
+
+  void emplace(entt::registry& reg, EntityMapping const& mapping) override
+  {
+    auto comps = std::vector<T*>{};
+    comps.reserve(instances.size());
+    for (auto& comp : instances) {
+      for (auto const& field : component.entity_refs) {
+        field.remap(comp, mapping);
+      }
+      comps.push_back(&comp);
+    }
+    ReflectionFunctions::migrateInstances<T>(
+      component.migrations, from, to, comps);
+
+    for (auto i = 0UL; i < entities.size(); ++i) {
+      reg.emplace_or_replace<T>(entities[i], std::move(instances[i]));
+    }
+  }
+
+  TypedSchemaPending(TypedSchemaComponent<T> const& in_component,
+                     std::uint32_t in_from,
+                     std::uint32_t in_to)
+    : component(in_component)
+    , from(in_from)
+    , to(in_to)
+  {}
+
+private:
+  TypedSchemaComponent<T> const& component;
+  std::uint32_t from;
+  std::uint32_t to;
+  std::vector<entt::entity> entities;
+  std::vector<T> instances;
+};
+
+template<typename T>
+std::unique_ptr<SchemaPending>
+TypedSchemaComponent<T>::makePending(std::uint32_t from, std::uint32_t to) const
+{
+  return std::make_unique<TypedSchemaPending<T>>(*this, from, to);
+}
+
+template<typename T>
+void
+schemaSave(entt::registry const& reg, entt::entity e, OutputArchive archive)
+{
+  if constexpr (std::is_empty_v<T>) {
+    archive(T{});
+  } else {
+    archive(reg.get<T>(e));
+  }
+}
+
+template<typename T>
+void
+schemaLoad(entt::registry& reg, entt::entity e, InputArchive archive)
+{
+  auto comp = T{};
+  archive(comp);
+  reg.emplace_or_replace<T>(e, std::move(comp));
+}
+
+} // namespace detail
+
+/**
+ * Set of components which snapshots are saved and loaded against, instead of
+ * the global entt::meta context. Schemas own their dense type table and are
+ * independent of each other, hence different worlds can use different
+ * components. Once built, a schema is only read, so concurrent saves and
+ * loads of different registries don't need any synchronization.
+ *
+ * Snapshots start with the type table, records refer to the components by
+ * their index into it. Loading maps saved indices to the schema's once, each
+ * record is then looked up by array index.
+ *
+ * The schema decides which components are saved, there are no ShouldSerialize
+ * predicates; components missing in the schema are neither saved nor loaded.
+ * Tags are saved per entity like other components, and the packed order of
+ * the other storages is restored.
+ * */
+class Schema
+{
+public:
+  static constexpr auto npos = std::numeric_limits<std::size_t>::max();
+
+  /**
+   * Adds component T. Migrations and entity references registered globally
+   * don't apply to schemas, they are registered per schema instead.
+   * */
+  template<typename T, std::string_view const& Str, std::uint32_t Version = 0>
+  Schema& reflectComponent()
+  {
+    if (index(Str) != npos) {
+      throw std::runtime_error("Schema already contains " + std::string{ Str });
+    }
+
+    auto i = entries.size();
+    entries.push_back(Entry{ .name = std::string{ Str },
+                             .version = Version,
+                             .save = &detail::schemaSave<T>,
+                             .load = &detail::schemaLoad<T>,
+                             .sort_as = sortAs<T>(),
+                             .component = std::make_unique<
+                               detail::TypedSchemaComponent<T>>() });
+    name_indices.emplace(entries.back().name, i);
+    type_indices.emplace(entt::type_hash<T>::value(), i);
+    return *this;
+  }
+
+  /**
+   * Registers the migration of the contained component T from version from
+   * to from + 1.
+   * */
+  template<typename T>
+  Schema& registerMigration(std::uint32_t from, Migration<T> migration)
+  {
+    typedComponent<T>().migrations[from] = std::move(migration);
+    return *this;
+  }
+
+  /**
+   * Marks Member of the contained component T as reference to other
+   * entities, like the global registerEntityRef.
+   * */
+  template<typename T, auto Member>
+  Schema& registerEntityRef()
+  {
+    detail::addEntityRefField<T, Member>(typedComponent<T>().entity_refs);
+    return *this;
+  }
+
+  std::size_t size() const noexcept { return entries.size(); }
+  std::string_view name(std::size_t i) const { return entries.at(i).name; }
+
+  /**
+   * Index of the component in the type table, or npos.
+   * */
+  std::size_t index(std::string_view name) const;
+  template<typename T>
+  std::size_t index() const
+  {
+    return typeIndex(entt::type_hash<T>::value());
+  }
+
+  void save(OutputArchive, entt::registry const&) const;
+  void load(InputArchive, entt::registry&) const;
+
+private:
+  struct Entry
+  {
+    std::string name;
+    std::uint32_t version;
+    void (*save)(entt::registry const&, entt::entity, OutputArchive);
+    void (*load)(entt::registry&, entt::entity, InputArchive);
+    /**
+     * Null for tags, whose order isn't kept.
+     * */
+    void (*sort_as)(entt::registry*, std::vector<entt::entity> const*);
+    std::unique_ptr<detail::SchemaComponent> component;
+  };
+
+  template<typename T>
+  static constexpr auto sortAs()
+    -> void (*)(entt::registry*, std::vector<entt::entity> const*)
+  {
+    if constexpr (std::is_empty_v<T>) {
+      return nullptr;
+    } else {
+      return &ReflectionFunctions::doSortAs<T>;
+    }
+  }
+
+  /**
+   * Per-entity record of a schema snapshot.
+   * */
+  struct SavedEntity
+  {
+    Schema const& schema;
+    entt::registry const& reg;
+    entt::entity e;
+    std::span<std::size_t const> components;
+
+    template<typename Archive>
+    void save(Archive& archive) const
+    {
+      auto sz_e = static_cast<std::uint64_t>(entt::to_integral(e));
+      archive(cereal::make_nvp("e", sz_e));
+
+      archive(cereal::make_size_tag(
+        static_cast<cereal::size_type>(components.size())));
+      for (auto i : components) {
+        auto const& entry = schema.entries[i];
+        archive(static_cast<std::uint32_t>(i));
+
+        if constexpr (detail::HAS_RECORDS<Archive>) {
+          detail::saveRecord(archive, [this, &entry](Archive& record) {
+            entry.save(reg, e, record);
+          });
+        } else {
+          entry.save(reg, e, archive);
+        }
+      }
+    }
+  };
+
+  struct LoadedEntity
+  {
+    Schema const& schema;
+    entt::registry& reg;
+    /**
+     * Saved type indices mapped to the schema's, npos for unknown types.
+     * */
+    std::vector<std::size_t> const& indices;
+    /**
+     * Buffers per schema index, only set for components which need to be
+     * migrated or remapped.
+     * */
+    std::vector<std::unique_ptr<detail::SchemaPending>> const& pending;
+    detail::EntityMapping& entities;
+
+    template<typename Archive>
+    void load(Archive& archive)
+    {
+      auto sz_e = std::uint64_t{ 0 };
+      archive(cereal::make_nvp("e", sz_e));
+      auto saved = static_cast<entt::entity>(sz_e);
+      auto e = reg.create(saved);
+      entities.emplace(saved, e);
+
+      auto count = cereal::size_type{ 0 };
+      archive(cereal::make_size_tag(count));
+      for (auto j = cereal::size_type{ 0 }; j < count; ++j) {
+        auto saved_index = std::uint32_t{ 0 };
+        archive(saved_index);
+        auto i = schema.translate(indices, saved_index);
+
+        if constexpr (detail::HAS_RECORDS<Archive>) {
+          detail::loadRecord(archive, i != npos, [this, i, e](Archive& record) {
+            loadComponent(i, e, record);
+          });
+        } else {
+          if (i == npos) {
+            throw std::runtime_error(
+              "Text snapshots can't skip components missing in the schema");
+          }
+          loadComponent(i, e, archive);
+        }
+      }
+    }
+
+    void loadComponent(std::size_t i, entt::entity e, InputArchive archive)
+    {
+      if (pending[i]) {
+        pending[i]->load(e, archive);
+      } else {
+        schema.entries[i].load(reg, e, archive);
+      }
+    }
+  };
+
+  template<typename T>
+  detail::TypedSchemaComponent<T>& typedComponent()
+  {
+    auto i = index<T>();
+    if (i == npos) {
+      throw std::runtime_error("Schema doesn't contain the component");
+    }
+    return static_cast<detail::TypedSchemaComponent<T>&>(
+      *entries[i].component);
+  }
+
+  std::size_t typeIndex(entt::id_type type_hash) const;
+  std::size_t translate(std::vector<std::size_t> const& indices,
+                        std::uint32_t saved_index) const;
+
+private:
+  std::vector<Entry> entries;
+  std::unordered_map<std::string, std::size_t> name_indices;
+  /**
+   * Indices by entt::type_hash, i.e. by the registry's storage ids.
+   * */
+  std::unordered_map<entt::id_type, std::size_t> type_indices;
+};
+
+} // namespace snapshot
@@ -1,10 +1,90 @@
 #pragma once
 
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+
 #include "Archive.hpp"
 #include "Reflection.hpp"
 
 namespace snapshot {
 
+using ShouldSerializePred = std::function<bool(char const*)>;
+using ShouldLoadEntityPred = std::function<bool(entt::entity)>;
+
+namespace ShouldSerialize {
+
+inline ShouldSerializePred
+tautology()
+{
+  return [](std::string const&) { return true; };
+}
+
+} // namespace ShouldSerialize
+
+namespace ShouldLoadEntity {
+
+inline ShouldLoadEntityPred
+tautology()
+{
+  return [](entt::entity) { return true; };
+}
+
+/**
+ * Accepts entities whose identifier lies within [first, last), regardless of
+ * their versions.
+ * */
+inline ShouldLoadEntityPred
+range(entt::entity first, entt::entity last)
+{
+  return [first = entt::to_entity(first),
+          last = entt::to_entity(last)](entt::entity e) {
+    auto value = entt::to_entity(e);
+    return first <= value && value < last;
+  };
+}
+
+} // namespace ShouldLoadEntity
+
+/**
+ * Batched notifications about components loaded with deferred signals.
+ * Instead of one construction signal per instance, listeners receive all
+ * entities which got the component once the load completed.
+ * */
+class LoadSignals
+{
+public:
+  using Signal =
+    entt::sigh<void(entt::registry&, std::span<entt::entity const>)>;
+
+  /**
+   * Throws if T isn't a reflected component, since it would never be
+   * published.
+   * */
+  template<typename T>
+  auto onLoaded()
+  {
+    auto type = entt::resolve<T>();
+    if (!type || !type.func(SAVE_FN_NAME)) {
+      throw std::runtime_error("LoadSignals: component isn't reflected");
+    }
+    return entt::sink{ signal(type.id()) };
+  }
+
+  void publish(entt::id_type meta_id,
+               entt::registry& reg,
+               std::vector<entt::entity> const& entities);
+
+private:
+  Signal& signal(entt::id_type meta_id);
+
+private:
+  std::unordered_map<entt::id_type, Signal> signals;
+};
+
 namespace detail {
 
 struct SerializeHandleEntity
@@ -17,7 +97,7 @@ private:
   template<typename Archive>
   void save(Archive& archive) const
   {
-    auto sz_e = static_cast<size_t>(e);
+    auto sz_e = static_cast<std::uint64_t>(entt::to_integral(e));
 
     archive(cereal::make_nvp("e", sz_e));
     archive(CEREAL_NVP(components));
@@ -29,10 +109,52 @@ private:
   }
 };
 
+struct ComponentRecord
+{
+  Any component;
+  ShouldSerializePred const& should_load;
+
+  template<typename Archive>
+  void load(Archive& archive)
+  {
+    component.loadIf(archive, should_load);
+  }
+};
+
+/**
+ * Loads like a std::vector<Any>, but only keeps the components accepted by
+ * should_load.
+ * */
+struct ComponentRecords
+{
+  std::vector<Any>& components;
+  ShouldSerializePred const& should_load;
+
+  template<typename Archive>
+  void load(Archive& archive)
+  {
+    auto count = cereal::size_type{ 0 };
+    archive(cereal::make_size_tag(count));
+
+    components.reserve(count);
+    for (auto i = cereal::size_type{ 0 }; i < count; ++i) {
+      auto record =
+        ComponentRecord{ .component = Any{}, .should_load = should_load };
+      archive(record);
+      if (record.component) {
+        components.push_back(std::move(record.component));
+      }
+    }
+  }
+};
+
 struct SerializeEntity
 {
   entt::entity e;
   std::vector<Any> components;
+  ShouldSerializePred const& should_serialize;
+  ShouldLoadEntityPred const& should_load_entity;
+  bool skipped = false;
 
 private:
   friend class cereal::access;
@@ -44,49 +166,345 @@ private:
   template<typename Archive>
   void load(Archive& archive)
   {
-    auto sz_e = 0UL;
+    static auto const reject = ShouldSerializePred{
+      [](char const*) { return false; }
+    };
+
+    auto sz_e = std::uint64_t{ 0 };
     archive(cereal::make_nvp("e", sz_e));
     e = static_cast<entt::entity>(sz_e);
+    skipped = !should_load_entity(e);
 
-    archive(CEREAL_NVP(components));
+    // skipped entities aren't decoded, hence not measured
+    auto scope = std::optional<ProfileScope>{};
+    if (!skipped) {
+      scope.emplace(ProfileOp::decode, e);
+    }
+
+    auto records = ComponentRecords{
+      .components = components,
+      .should_load = skipped ? reject : should_serialize
+    };
+    archive(cereal::make_nvp("components", records));
   }
 };
 
-} // namespace detail
+/**
+ * Packed order of a storage at the time of saving. Tags don't keep one, and
+ * neither do storages already in the order their entities are saved in.
+ * */
+struct StorageOrder
+{
+  std::string name;
+  std::vector<std::uint64_t> entities;
 
-using ShouldSerializePred = std::function<bool(char const*)>;
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(name), CEREAL_NVP(entities));
+  }
+};
 
-namespace ShouldSerialize {
+/**
+ * Entities having a tag, saved as sorted runs of consecutive identifiers
+ * instead of one record per instance.
+ * */
+struct TagSet
+{
+  std::string name;
+  /**
+   * Pairs of first entity identifier and length of each run. Runs ignore
+   * versions, so recycled identifiers don't split them.
+   * */
+  std::vector<std::uint64_t> runs;
+  /**
+   * Pairs of index in the order of the runs and version, only for entities
+   * whose version isn't zero.
+   * */
+  std::vector<std::uint32_t> versions;
 
-inline ShouldSerializePred
-tautology()
+  void assign(std::vector<std::uint64_t> const& ids)
+  {
+    auto entities = std::vector<entt::entity>{};
+    entities.reserve(ids.size());
+    for (auto id : ids) {
+      entities.push_back(static_cast<entt::entity>(id));
+    }
+    std::sort(entities.begin(),
+              entities.end(),
+              [](entt::entity lhs, entt::entity rhs) {
+                return entt::to_entity(lhs) < entt::to_entity(rhs);
+              });
+
+    runs.clear();
+    versions.clear();
+    auto index = std::uint32_t{ 0 };
+    for (auto e : entities) {
+      auto id = std::uint64_t{ entt::to_entity(e) };
+      auto size = runs.size();
+      if (size != 0 && runs[size - 2] + runs[size - 1] == id) {
+        ++runs[size - 1];
+      } else {
+        runs.push_back(id);
+        runs.push_back(1);
+      }
+
+      if (auto version = entt::to_version(e); version != 0) {
+        versions.push_back(index);
+        versions.push_back(version);
+      }
+      ++index;
+    }
+  }
+
+  template<typename Func>
+  void each(Func&& func) const
+  {
+    using traits = entt::entt_traits<entt::entity>;
+
+    auto index = std::uint64_t{ 0 };
+    auto next = 0UL;
+    for (auto i = 0UL; i + 1 < runs.size(); i += 2) {
+      for (auto id = runs[i], last = id + runs[i + 1]; id != last; ++id) {
+        auto version = std::uint32_t{ 0 };
+        if (next + 1 < versions.size() && versions[next] == index) {
+          version = versions[next + 1];
+          next += 2;
+        }
+        func(traits::construct(static_cast<traits::entity_type>(id),
+                               static_cast<traits::version_type>(version)));
+        ++index;
+      }
+    }
+    if (next != versions.size()) {
+      throw std::runtime_error("TagSet: versions don't match the runs");
+    }
+  }
+
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(name), CEREAL_NVP(runs), CEREAL_NVP(versions));
+  }
+};
+
+/**
+ * Versions of the saved components, by name.
+ * */
+using ComponentVersions = std::map<std::string, std::uint32_t>;
+
+/**
+ * State shared by the passes of loading a registry.
+ * */
+struct LoadContext
 {
-  return [](std::string const&) { return true; };
-}
+  /**
+   * Saved entities mapped to the ones created while loading.
+   * */
+  std::unordered_map<entt::entity, entt::entity> entities;
+  /**
+   * Saved versions of components older than their reflected version, by
+   * meta-type id.
+   * */
+  std::unordered_map<entt::id_type, std::uint32_t> outdated;
+  /**
+   * Set if signals are deferred, collects the loaded entities per component.
+   * */
+  LoadSignals* signals = nullptr;
+  std::unordered_map<entt::id_type, std::vector<entt::entity>> emplaced;
+  /**
+   * Loaded components which have to be remapped or migrated, by meta-type
+   * id. They are only emplaced once fixed up, so that construction
+   * listeners observe their final values.
+   * */
+  struct Pending
+  {
+    std::vector<entt::entity> entities;
+    std::vector<Any> components;
+  };
+  std::unordered_map<entt::id_type, Pending> pending;
+  /**
+   * Whether references are remapped, handle loads keep them as saved.
+   * */
+  bool remap_entity_refs = true;
+  std::unordered_map<entt::id_type, bool> has_entity_refs;
 
-} // namespace ShouldSerialize
+  void setVersions(ComponentVersions const& versions)
+  {
+    for (auto const& [name, version] : versions) {
+      auto refl_comp = ComponentReflection{ Reflection{ name } };
+      if (refl_comp && version < refl_comp.version()) {
+        outdated.emplace(refl_comp.reflection().type().id(), version);
+      }
+    }
+  }
+
+  bool hasEntityRefs(Any const& comp)
+  {
+    auto id = comp.reflection().type().id();
+    auto it = has_entity_refs.find(id);
+    if (it == has_entity_refs.end()) {
+      it = has_entity_refs
+             .emplace(id, comp.componentReflection().hasEntityRefs())
+             .first;
+    }
+    return it->second;
+  }
 
+  /**
+   * Emplaces comp, or keeps it pending if it has to be fixed up first.
+   * */
+  void load(entt::handle h, Any& comp)
+  {
+    auto id = comp.reflection().type().id();
+    if (outdated.contains(id) || (remap_entity_refs && hasEntityRefs(comp))) {
+      auto& entry = pending[id];
+      entry.entities.push_back(h.entity());
+      entry.components.push_back(std::move(comp));
+    } else {
+      emplace(h, comp);
+    }
+  }
+
+  void emplace(entt::handle h, Any& comp)
+  {
+    if (signals) {
+      comp.componentReflection().emplaceSilent(h, *comp);
+      emplaced[comp.reflection().type().id()].push_back(h.entity());
+    } else {
+      comp.componentReflection().emplace(h, *comp);
+    }
+  }
+
+  entt::entity translate(entt::entity saved) const
+  {
+    auto it = entities.find(saved);
+    return it != entities.end() ? it->second : entt::entity{ entt::null };
+  }
+};
+
+} // namespace detail
+
+/**
+ * Snapshots start with the versions of the saved components. Registries are
+ * then saved entity by entity, followed by the entities of each tag and the
+ * packed order of each saved storage. Tags aren't part of the entities'
+ * components, except for snapshots of single handles. Those have empty tag
+ * and order sections, so they can be loaded into registries as well.
+ * */
 class Snapshot
 {
 public:
   static void save(OutputArchive, entt::const_handle, ShouldSerializePred);
   static void save(OutputArchive, entt::registry const&, ShouldSerializePred);
+  /**
+   * Saves roots and all entities they transitively reference via
+   * registerEntityRef, in the same format as whole registries.
+   * */
+  static void save(OutputArchive,
+                   entt::registry const&,
+                   std::vector<entt::entity> const& roots,
+                   ShouldSerializePred);
+
+  /**
+   * Roots followed by all entities they transitively reference, in
+   * breadth-first order. Only references of components accepted by
+   * should_serialize are followed.
+   * */
+  static std::vector<entt::entity> closure(
+    entt::registry const&,
+    std::vector<entt::entity> const& roots,
+    ShouldSerializePred const& should_serialize);
 
 private:
   static void saveHandle(OutputArchive&,
                          entt::const_handle,
-                         ShouldSerializePred);
+                         ShouldSerializePred,
+                         bool skip_tags);
+  /**
+   * If passed, subset restricts the saved entities.
+   * */
+  static void saveTags(OutputArchive&,
+                       entt::registry const&,
+                       ShouldSerializePred const&,
+                       std::vector<entt::entity> const* subset);
+  static void saveStorageOrder(OutputArchive&,
+                               entt::registry const&,
+                               ShouldSerializePred const&,
+                               std::vector<entt::entity> const* subset);
+  static void saveVersions(OutputArchive&,
+                           entt::registry const&,
+                           ShouldSerializePred const&);
+  static void saveVersions(OutputArchive&,
+                           entt::const_handle,
+                           ShouldSerializePred const&);
 };
 
+/**
+ * Components rejected by ShouldSerializePred and entities rejected by
+ * ShouldLoadEntityPred are neither constructed nor, for binary archives,
+ * decoded.
+ * */
 class SnapshotLoader
 {
 public:
+  /**
+   * Loads the components of a single entity into h. Entity references are
+   * kept as saved, since there is no mapping of the saved entities.
+   * */
   static void load(InputArchive, entt::handle, ShouldSerializePred);
   static void load(InputArchive, entt::registry&, ShouldSerializePred);
+  static void load(InputArchive,
+                   entt::registry&,
+                   ShouldSerializePred,
+                   ShouldLoadEntityPred);
+  /**
+   * Loads without publishing construction or update signals, instead signals
+   * publishes one notification per component type after loading. Throws if
+   * a loaded component has listeners, e.g. groups or observers, which would
+   * miss the silently loaded instances.
+   * */
+  static void load(InputArchive,
+                   entt::registry&,
+                   ShouldSerializePred,
+                   ShouldLoadEntityPred,
+                   LoadSignals& signals);
+
+  /**
+   * Sorts the storages of all named components like the first one's, so that
+   * views over them iterate contiguously. Useful after loading, as storages
+   * are sorted like at the time of saving.
+   * */
+  static void coSort(entt::registry&, std::vector<std::string> const& names);
 
 private:
-  static void loadHandle(InputArchive, entt::registry&, ShouldSerializePred);
-  static void loadHandle(InputArchive, entt::handle, ShouldSerializePred);
+  static void loadRegistry(InputArchive,
+                           entt::registry&,
+                           ShouldSerializePred const&,
+                           ShouldLoadEntityPred const&,
+                           detail::LoadContext&);
+  static void loadHandle(InputArchive,
+                         entt::registry&,
+                         ShouldSerializePred const&,
+                         ShouldLoadEntityPred const&,
+                         detail::LoadContext&);
+  static void loadTags(InputArchive,
+                       entt::registry&,
+                       ShouldSerializePred const&,
+                       detail::LoadContext&);
+  static void loadStorageOrder(InputArchive,
+                               entt::registry&,
+                               ShouldSerializePred const&,
+                               detail::LoadContext const&);
+  static void loadHandle(InputArchive,
+                         entt::handle,
+                         ShouldSerializePred const&,
+                         detail::LoadContext&);
+  static void loadVersions(InputArchive, detail::LoadContext&);
+  /**
+   * Remaps and migrates the pending components, then emplaces them.
+   * */
+  static void emplacePending(entt::registry&, detail::LoadContext&);
 };
 
 } // namespace snapshot
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+namespace snapshot {
+
+namespace detail {
+
+/**
+ * Copy of a single component storage, used by RollbackBuffer. The buffers are
+ * kept across captures, so capturing doesn't allocate once they are large
+ * enough.
+ * */
+class StorageCopy
+{
+public:
+  /**
+   * Copies the storage in its packed order.
+   * */
+  virtual void capture(entt::registry const& reg) = 0;
+  /**
+   * Replaces the storage's content by the copy, keeping its capacity. Values
+   * are assigned in place without publishing any signals, only instances
+   * added or removed since the capture are removed or emplaced. Components
+   * which aren't copy assignable are cleared and refilled instead. The
+   * copied entities must be valid.
+   * */
+  virtual void restore(entt::registry& reg) const = 0;
+  /**
+   * Whether the storage equals the copy, comparing all instances bytewise.
+   * Always false for components which aren't trivially copyable.
+   * */
+  virtual bool equals(entt::registry const& reg) const = 0;
+
+  virtual ~StorageCopy() = default;
+};
+
+template<typename T>
+class TypedStorageCopy : public StorageCopy
+{
+public:
+  void capture(entt::registry const& reg) override
+  {
+    auto const& storage = reg.storage<T>();
+    entities.assign(storage.data(), storage.data() + storage.size());
+
+    // reverse iterators walk the packed array in order
+    if constexpr (!std::is_empty_v<T>) {
+      values.assign(storage.rbegin(), storage.rend());
+    }
+  }
+
+  void restore(entt::registry& reg) const override
+  {
+    if constexpr (std::is_copy_assignable_v<T>) {
+      auto& storage = reg.storage<T>();
+      if (!samePacked(storage)) {
+        reconcile(reg, storage);
+      }
+
+      if constexpr (!std::is_empty_v<T>) {
+        if (samePacked(storage)) {
+          std::copy(values.begin(), values.end(), storage.rbegin());
+        } else {
+          // groups owning the storage keep their own order
+          for (auto i = 0UL; i < entities.size(); ++i) {
+            storage.get(entities[i]) = values[i];
+          }
+        }
+      }
+    } else {
+      reg.clear<T>();
+      if constexpr (std::is_empty_v<T>) {
+        reg.insert<T>(entities.begin(), entities.end());
+      } else {
+        reg.insert<T>(entities.begin(), entities.end(), values.begin());
+      }
+    }
+  }
+
+  bool equals(entt::registry const& reg) const override
+  {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      auto const& storage = reg.storage<T>();
+      if (!samePacked(storage)) {
+        return false;
+      }
+
+      // bytewise equal instances are identical, other differences only
+      // cause a needless copy
+      if constexpr (!std::is_empty_v<T>) {
+        return std::equal(values.begin(),
+                          values.end(),
+                          storage.rbegin(),
+                          [](T const& lhs, T const& rhs) {
+                            return std::memcmp(&lhs, &rhs, sizeof(T)) == 0;
+                          });
+      }
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+private:
+  template<typename Storage>
+  bool samePacked(Storage const& storage) const
+  {
+    return storage.size() == entities.size() &&
+           std::equal(entities.begin(), entities.end(), storage.data());
+  }
+
+  /**
+   * Removes the instances added since the capture and emplaces the removed
+   * ones, then moves the copied entities to their copied positions unless a
+   * group owns the storage.
+   * */
+  template<typename Storage>
+  void reconcile(entt::registry& reg, Storage& storage) const
+  {
+    sorted.assign(entities.begin(), entities.end());
+    std::sort(sorted.begin(), sorted.end());
+    auto added = std::vector<entt::entity>{};
+    std::copy_if(storage.data(),
+                 storage.data() + storage.size(),
+                 std::back_inserter(added),
+                 [this](entt::entity e) {
+                   return !std::binary_search(sorted.begin(), sorted.end(), e);
+                 });
+    reg.remove<T>(added.begin(), added.end());
+
+    for (auto i = 0UL; i < entities.size(); ++i) {
+      if (!storage.contains(entities[i])) {
+        if constexpr (std::is_empty_v<T>) {
+          reg.emplace<T>(entities[i]);
+        } else {
+          reg.emplace<T>(entities[i], values[i]);
+        }
+      }
+    }
+
+    if (!reg.sortable<T>()) {
+      return;
+    }
+    for (auto pos = 0UL; pos < entities.size(); ++pos) {
+      auto e = entities[pos];
+      if (storage.index(e) != pos) {
+        storage.swap_elements(storage.data()[pos], e);
+      }
+    }
+  }
+
+private:
+  std::vector<entt::entity> entities;
+  std::vector<T> values;
+  mutable std::vector<entt::entity> sorted;
+};
+
+} // namespace detail
+
+} // namespace snapshot
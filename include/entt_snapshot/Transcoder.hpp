@@ -0,0 +1,54 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+
+#include "MappedSnapshot.hpp"
+#include "Snapshot.hpp"
+
+namespace snapshot {
+
+enum class SnapshotFormat
+{
+  json,
+  binary,
+  portable,
+  mapped
+};
+
+SnapshotFormat
+parseSnapshotFormat(std::string_view);
+
+/**
+ * Converts snapshots between formats using only the reflected components, no
+ * registry is involved. Entities are converted in chunks of a few hundred,
+ * outdated components are migrated once per chunk and type, so memory stays
+ * bounded. Between files of the same binary format, component records are
+ * copied undecoded unless components have to be migrated.
+ * */
+class Transcoder
+{
+public:
+  static void transcode(InputArchive, OutputArchive, ShouldSerializePred);
+  static void transcode(InputArchive,
+                        MappedSnapshotWriter&,
+                        ShouldSerializePred);
+  static void transcode(SnapshotView&, OutputArchive, ShouldSerializePred);
+  static void transcode(SnapshotView&,
+                        MappedSnapshotWriter&,
+                        ShouldSerializePred);
+
+  static void transcode(std::filesystem::path const& in,
+                        SnapshotFormat from,
+                        std::filesystem::path const& out,
+                        SnapshotFormat to,
+                        ShouldSerializePred);
+
+  /**
+   * Command line interface, see tools/transcode.cpp. Multiple files are
+   * converted in parallel. Fails if no component is reflected.
+   * */
+  static int main(int argc, char** argv);
+};
+
+} // namespace snapshot
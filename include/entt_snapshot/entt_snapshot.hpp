@@ -1,5 +1,16 @@
 #pragma once
 
 #include "Archive.hpp"
+#include "BufferArchive.hpp"
+#include "Checksum.hpp"
+#include "Endian.hpp"
+#include "Hash.hpp"
+#include "Journal.hpp"
+#include "MappedSnapshot.hpp"
+#include "Profiler.hpp"
 #include "Reflection.hpp"
-#include "Snapshot.hpp"
\ No newline at end of file
+#include "RollbackBuffer.hpp"
+#include "Schema.hpp"
+#include "Snapshot.hpp"
+#include "StorageCopy.hpp"
+#include "Transcoder.hpp"
\ No newline at end of file
@@ -6,12 +6,30 @@ namespace snapshot {
 
 OutputArchive::OutputArchive(cereal::BinaryOutputArchive& binary)
   : binary(&binary)
+  , portable(nullptr)
   , json(nullptr)
+  , buffer(nullptr)
+{}
+
+OutputArchive::OutputArchive(cereal::PortableBinaryOutputArchive& portable)
+  : binary(nullptr)
+  , portable(&portable)
+  , json(nullptr)
+  , buffer(nullptr)
 {}
 
 OutputArchive::OutputArchive(cereal::JSONOutputArchive& json)
   : binary(nullptr)
+  , portable(nullptr)
   , json(&json)
+  , buffer(nullptr)
+{}
+
+OutputArchive::OutputArchive(BufferOutputArchive& buffer)
+  : binary(nullptr)
+  , portable(nullptr)
+  , json(nullptr)
+  , buffer(&buffer)
 {}
 
 #pragma endregion // output_archive
@@ -20,11 +38,27 @@ OutputArchive::OutputArchive(cereal::JSONOutputArchive& json)
 
 InputArchive::InputArchive(cereal::BinaryInputArchive& binary)
   : binary(&binary)
+  , portable(nullptr)
+  , json(nullptr)
+  , buffer(nullptr)
+{}
+InputArchive::InputArchive(cereal::PortableBinaryInputArchive& portable)
+  : binary(nullptr)
+  , portable(&portable)
   , json(nullptr)
+  , buffer(nullptr)
 {}
 InputArchive::InputArchive(cereal::JSONInputArchive& json)
   : binary(nullptr)
+  , portable(nullptr)
   , json(&json)
+  , buffer(nullptr)
+{}
+InputArchive::InputArchive(BufferInputArchive& buffer)
+  : binary(nullptr)
+  , portable(nullptr)
+  , json(nullptr)
+  , buffer(&buffer)
 {}
 
 #pragma endregion // input_archive
@@ -36,29 +70,54 @@ Archive::Archive(cereal::BinaryOutputArchive& binary_out)
   setNull();
   this->binary_out = &binary_out;
 }
+Archive::Archive(cereal::PortableBinaryOutputArchive& portable_out)
+{
+  setNull();
+  this->portable_out = &portable_out;
+}
 Archive::Archive(cereal::JSONOutputArchive& json_out)
 {
   setNull();
   this->json_out = &json_out;
 }
+Archive::Archive(BufferOutputArchive& buffer_out)
+{
+  setNull();
+  this->buffer_out = &buffer_out;
+}
 Archive::Archive(cereal::BinaryInputArchive& binary_in)
 {
   setNull();
   this->binary_in = &binary_in;
 }
+Archive::Archive(cereal::PortableBinaryInputArchive& portable_in)
+{
+  setNull();
+  this->portable_in = &portable_in;
+}
 Archive::Archive(cereal::JSONInputArchive& json_in)
 {
   setNull();
   this->json_in = &json_in;
 }
 
+Archive::Archive(BufferInputArchive& buffer_in)
+{
+  setNull();
+  this->buffer_in = &buffer_in;
+}
+
 void
 Archive::setNull()
 {
   binary_out = nullptr;
+  portable_out = nullptr;
   json_out = nullptr;
+  buffer_out = nullptr;
   binary_in = nullptr;
+  portable_in = nullptr;
   json_in = nullptr;
+  buffer_in = nullptr;
 }
 
 #pragma endregion // archive
@@ -0,0 +1,59 @@
+#include <entt_snapshot/BufferArchive.hpp>
+
+#include <algorithm>
+
+namespace snapshot {
+
+namespace {
+
+constexpr auto MIN_GROWABLE_CAPACITY = std::size_t{ 256 };
+
+} // namespace
+
+#pragma region buffer_output_archive
+
+BufferOutputArchive::BufferOutputArchive(std::vector<std::byte>& buffer)
+  : cereal::OutputArchive<BufferOutputArchive,
+                          cereal::AllowEmptyClassElision>(this)
+  , growable(&buffer)
+  , begin(nullptr)
+  , capacity(0)
+  , position(buffer.size())
+{
+  buffer.reserve(std::max(buffer.capacity(), MIN_GROWABLE_CAPACITY));
+}
+
+BufferOutputArchive::BufferOutputArchive(std::span<std::byte> buffer)
+  : cereal::OutputArchive<BufferOutputArchive,
+                          cereal::AllowEmptyClassElision>(this)
+  , growable(nullptr)
+  , begin(buffer.data())
+  , capacity(buffer.size())
+  , position(0)
+{}
+
+BufferOutputArchive::BufferOutputArchive(RecordTag,
+                                         BufferOutputArchive const& parent)
+  : cereal::OutputArchive<BufferOutputArchive,
+                          cereal::AllowEmptyClassElision>(this)
+  , growable(parent.growable)
+  , begin(parent.begin)
+  , capacity(parent.capacity)
+  , position(parent.position)
+{}
+
+#pragma endregion // buffer_output_archive
+
+#pragma region buffer_input_archive
+
+BufferInputArchive::BufferInputArchive(std::span<std::byte const> buffer)
+  : cereal::InputArchive<BufferInputArchive, cereal::AllowEmptyClassElision>(
+      this)
+  , buffer(buffer)
+  , position(0)
+  , checked(true)
+{}
+
+#pragma endregion // buffer_input_archive
+
+} // namespace snapshot
@@ -0,0 +1,85 @@
+#include <entt_snapshot/Checksum.hpp>
+
+#include <algorithm>
+#include <future>
+
+namespace snapshot {
+
+#pragma region registry_checksum
+
+std::vector<std::string>
+RegistryChecksum::changed(RegistryChecksum const& other) const
+{
+  auto res = std::vector<std::string>{};
+
+  for (auto const& comp : components) {
+    auto it = std::lower_bound(
+      other.components.begin(),
+      other.components.end(),
+      comp.name,
+      [](ComponentChecksum const& c, std::string const& name) {
+        return c.name < name;
+      });
+
+    if (it == other.components.end() || it->name != comp.name ||
+        it->hash != comp.hash) {
+      res.push_back(comp.name);
+    }
+  }
+
+  return res;
+}
+
+#pragma endregion // registry_checksum
+
+#pragma region checksum
+
+RegistryChecksum
+Checksum::compute(entt::registry const& reg,
+                  ShouldSerializePred should_serialize)
+{
+  auto pending =
+    std::vector<std::pair<std::string, std::future<std::uint64_t>>>{};
+
+  for (auto&& [id, storage] : reg.storage()) {
+    auto refl_comp = ComponentReflection{ storage.type() };
+    if (!refl_comp) {
+      continue;
+    }
+
+    auto comp_name = refl_comp.reflection().name();
+    if (!should_serialize(comp_name.data())) {
+      continue;
+    }
+
+    auto policy = storage.size() < PARALLEL_THRESHOLD ? std::launch::deferred
+                                                      : std::launch::async;
+    pending.emplace_back(
+      std::string{ comp_name.data() },
+      std::async(policy, [refl_comp, &reg] { return refl_comp.hash(reg); }));
+  }
+
+  auto res = RegistryChecksum{ .hash = 0, .components = {} };
+  res.components.reserve(pending.size());
+  for (auto& [name, hash] : pending) {
+    res.components.push_back(
+      ComponentChecksum{ .name = std::move(name), .hash = hash.get() });
+  }
+
+  std::sort(res.components.begin(),
+            res.components.end(),
+            [](auto const& lhs, auto const& rhs) {
+              return lhs.name < rhs.name;
+            });
+
+  for (auto const& comp : res.components) {
+    auto name_hash = hashBytes(comp.name.data(), comp.name.size());
+    res.hash = hashCombine(res.hash, hashCombine(name_hash, comp.hash));
+  }
+
+  return res;
+}
+
+#pragma endregion // checksum
+
+} // namespace snapshot
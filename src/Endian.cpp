@@ -0,0 +1,29 @@
+#include <entt_snapshot/Endian.hpp>
+
+namespace snapshot {
+
+void
+byteswapColumn(std::uint16_t* data, std::size_t count)
+{
+  for (auto i = std::size_t{ 0 }; i < count; ++i) {
+    data[i] = __builtin_bswap16(data[i]);
+  }
+}
+
+void
+byteswapColumn(std::uint32_t* data, std::size_t count)
+{
+  for (auto i = std::size_t{ 0 }; i < count; ++i) {
+    data[i] = __builtin_bswap32(data[i]);
+  }
+}
+
+void
+byteswapColumn(std::uint64_t* data, std::size_t count)
+{
+  for (auto i = std::size_t{ 0 }; i < count; ++i) {
+    data[i] = __builtin_bswap64(data[i]);
+  }
+}
+
+} // namespace snapshot
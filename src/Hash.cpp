@@ -0,0 +1,121 @@
+#include <entt_snapshot/Hash.hpp>
+
+#include <bit>
+#include <cstring>
+
+namespace snapshot {
+
+namespace {
+
+constexpr auto PRIME_1 = 11400714785074694791ULL;
+constexpr auto PRIME_2 = 14029467366897019727ULL;
+constexpr auto PRIME_3 = 1609587929392839161ULL;
+constexpr auto PRIME_4 = 9650029242287828579ULL;
+constexpr auto PRIME_5 = 2870177450012600261ULL;
+
+std::uint64_t
+read64(unsigned char const* p)
+{
+  auto v = std::uint64_t{};
+  std::memcpy(&v, p, sizeof(v));
+  if constexpr (std::endian::native == std::endian::big) {
+    v = __builtin_bswap64(v);
+  }
+  return v;
+}
+
+std::uint32_t
+read32(unsigned char const* p)
+{
+  auto v = std::uint32_t{};
+  std::memcpy(&v, p, sizeof(v));
+  if constexpr (std::endian::native == std::endian::big) {
+    v = __builtin_bswap32(v);
+  }
+  return v;
+}
+
+std::uint64_t
+mixRound(std::uint64_t acc, std::uint64_t input)
+{
+  acc += input * PRIME_2;
+  acc = std::rotl(acc, 31);
+  return acc * PRIME_1;
+}
+
+std::uint64_t
+mergeRound(std::uint64_t acc, std::uint64_t val)
+{
+  acc ^= mixRound(0, val);
+  return acc * PRIME_1 + PRIME_4;
+}
+
+std::uint64_t
+avalanche(std::uint64_t h)
+{
+  h ^= h >> 33;
+  h *= PRIME_2;
+  h ^= h >> 29;
+  h *= PRIME_3;
+  h ^= h >> 32;
+  return h;
+}
+
+} // namespace
+
+std::uint64_t
+hashBytes(void const* data, std::size_t size, std::uint64_t seed)
+{
+  auto p = static_cast<unsigned char const*>(data);
+  auto const end = p + size;
+  auto h = std::uint64_t{};
+
+  if (size >= 32) {
+    auto v1 = seed + PRIME_1 + PRIME_2;
+    auto v2 = seed + PRIME_2;
+    auto v3 = seed;
+    auto v4 = seed - PRIME_1;
+
+    for (auto const limit = end - 32; p <= limit; p += 32) {
+      v1 = mixRound(v1, read64(p));
+      v2 = mixRound(v2, read64(p + 8));
+      v3 = mixRound(v3, read64(p + 16));
+      v4 = mixRound(v4, read64(p + 24));
+    }
+
+    h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) +
+        std::rotl(v4, 18);
+    h = mergeRound(h, v1);
+    h = mergeRound(h, v2);
+    h = mergeRound(h, v3);
+    h = mergeRound(h, v4);
+  } else {
+    h = seed + PRIME_5;
+  }
+
+  h += static_cast<std::uint64_t>(size);
+
+  for (; end - p >= 8; p += 8) {
+    h ^= mixRound(0, read64(p));
+    h = std::rotl(h, 27) * PRIME_1 + PRIME_4;
+  }
+  if (end - p >= 4) {
+    h ^= static_cast<std::uint64_t>(read32(p)) * PRIME_1;
+    h = std::rotl(h, 23) * PRIME_2 + PRIME_3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    h ^= static_cast<std::uint64_t>(*p) * PRIME_5;
+    h = std::rotl(h, 11) * PRIME_1;
+  }
+
+  return avalanche(h);
+}
+
+std::uint64_t
+hashCombine(std::uint64_t seed, std::uint64_t value)
+{
+  return avalanche(seed ^ (value + PRIME_5 + (seed << 6) + (seed >> 2)));
+}
+
+} // namespace snapshot
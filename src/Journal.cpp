@@ -0,0 +1,372 @@
+#include <entt_snapshot/Endian.hpp>
+#include <entt_snapshot/Hash.hpp>
+#include <entt_snapshot/Journal.hpp>
+#include <entt_snapshot/MemoryStream.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace snapshot {
+
+namespace {
+
+/**
+ * Each record is preceded by its size and hash.
+ * */
+constexpr auto FRAME_HEADER_SIZE = 2 * sizeof(std::uint64_t);
+
+void
+writeAll(int fd, std::string const& bytes)
+{
+  auto data = bytes.data();
+  auto remaining = bytes.size();
+  while (remaining > 0) {
+    auto written = ::write(fd, data, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Journal: failed to write journal");
+    }
+    data += written;
+    remaining -= static_cast<std::size_t>(written);
+  }
+}
+
+void
+syncPath(std::filesystem::path const& path)
+{
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Journal: failed to open " + path.string());
+  }
+  auto res = ::fsync(fd);
+  ::close(fd);
+  if (res != 0) {
+    throw std::runtime_error("Journal: failed to sync " + path.string());
+  }
+}
+
+} // namespace
+
+#pragma region journal
+
+void
+Journal::flush()
+{
+  auto lock = std::unique_lock{ mutex };
+  requested = appended;
+  wake.notify_one();
+  committed.wait(lock, [this] { return durable >= requested || error; });
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void
+Journal::compact()
+{
+  flush();
+
+  auto tmp = directory / (std::string{ SNAPSHOT_FILE } + ".tmp");
+  {
+    auto stream = std::ofstream{ tmp, std::ios::binary | std::ios::trunc };
+    if (!stream) {
+      throw std::runtime_error("Journal: failed to open " + tmp.string());
+    }
+    {
+      auto archive = cereal::BinaryOutputArchive{ stream };
+      Snapshot::save(archive, reg, should_serialize);
+    }
+    stream.flush();
+    if (!stream) {
+      throw std::runtime_error("Journal: failed to write " + tmp.string());
+    }
+  }
+  syncPath(tmp);
+
+  // the journal is only truncated once the new snapshot is in place,
+  // replaying it onto the new snapshot yields the same state
+  std::filesystem::rename(tmp, directory / SNAPSHOT_FILE);
+  syncPath(directory);
+
+  auto lock = std::lock_guard{ mutex };
+  if (::ftruncate(fd, 0) != 0) {
+    throw std::runtime_error("Journal: failed to truncate journal");
+  }
+  appended = 0;
+  durable = 0;
+  requested = 0;
+}
+
+bool
+Journal::compactIfNeeded()
+{
+  if (size() < options.compact_size) {
+    return false;
+  }
+  compact();
+  return true;
+}
+
+std::uint64_t
+Journal::size() const
+{
+  auto lock = std::lock_guard{ mutex };
+  return appended;
+}
+
+std::size_t
+Journal::recover(entt::registry& reg,
+                 std::filesystem::path const& directory,
+                 ShouldSerializePred should_serialize)
+{
+  auto snapshot_path = directory / SNAPSHOT_FILE;
+  if (std::filesystem::exists(snapshot_path)) {
+    auto stream = std::ifstream{ snapshot_path, std::ios::binary };
+    if (!stream) {
+      throw std::runtime_error("Journal: failed to open " +
+                               snapshot_path.string());
+    }
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, reg, should_serialize);
+  }
+
+  auto journal_path = directory / JOURNAL_FILE;
+  if (!std::filesystem::exists(journal_path)) {
+    return 0;
+  }
+
+  auto stream = std::ifstream{ journal_path, std::ios::binary };
+  if (!stream) {
+    throw std::runtime_error("Journal: failed to open " +
+                             journal_path.string());
+  }
+  auto journal = std::string{ std::istreambuf_iterator<char>{ stream },
+                              std::istreambuf_iterator<char>{} };
+  return replay(reg, journal, should_serialize);
+}
+
+std::size_t
+Journal::replay(entt::registry& reg,
+                std::string_view journal,
+                ShouldSerializePred const& should_serialize)
+{
+  // journaled entities which couldn't be recreated with their identifier
+  auto entities = std::unordered_map<entt::entity, entt::entity>{};
+  auto resolve = [&reg, &entities](entt::entity saved) {
+    auto it = entities.find(saved);
+    if (it != entities.end()) {
+      return it->second;
+    }
+
+    auto e = reg.valid(saved) ? saved : reg.create(saved);
+    if (e != saved) {
+      entities.emplace(saved, e);
+    }
+    return e;
+  };
+
+  auto count = 0UL;
+  auto offset = 0UL;
+  while (journal.size() - offset >= FRAME_HEADER_SIZE) {
+    auto size = std::uint64_t{ 0 };
+    auto hash = std::uint64_t{ 0 };
+    std::memcpy(&size, journal.data() + offset, sizeof(size));
+    std::memcpy(&hash, journal.data() + offset + sizeof(size), sizeof(hash));
+    size = fromLittleEndian(size);
+    hash = fromLittleEndian(hash);
+    offset += FRAME_HEADER_SIZE;
+
+    // a torn or corrupted record ends the journal
+    if (journal.size() - offset < size) {
+      break;
+    }
+    auto record = journal.data() + offset;
+    if (hashBytes(record, size) != hash) {
+      break;
+    }
+    offset += size;
+
+    auto stream = detail::MemoryInputStream{ record, size };
+    auto archive = cereal::BinaryInputArchive{ stream };
+
+    auto change = std::uint8_t{ 0 };
+    auto sz_e = std::uint64_t{ 0 };
+    archive(change, sz_e);
+    auto saved = static_cast<entt::entity>(sz_e);
+    auto h = entt::handle{ reg, resolve(saved) };
+
+    if (static_cast<ComponentChange>(change) == ComponentChange::update) {
+      auto comp = Any{};
+      comp.loadIf(archive, should_serialize);
+      if (comp) {
+        comp.componentReflection().emplace(h, *comp);
+      }
+    } else {
+      auto name = std::string{};
+      archive(name);
+      auto refl_comp = ComponentReflection{ Reflection{ name } };
+      if (refl_comp && should_serialize(name.c_str())) {
+        refl_comp.remove(h);
+      }
+
+      // destroyed right away, so that recreating its identifier later on
+      // reuses the slot
+      if (h.orphan()) {
+        h.destroy();
+        entities.erase(saved);
+      }
+    }
+    ++count;
+  }
+
+  return count;
+}
+
+void
+Journal::changed(entt::registry& changed_reg,
+                 entt::entity e,
+                 ComponentReflection const& refl_comp,
+                 ComponentChange change)
+{
+  auto stream = std::ostringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    archive(static_cast<std::uint8_t>(change),
+            static_cast<std::uint64_t>(entt::to_integral(e)));
+
+    if (change == ComponentChange::update) {
+      archive(Handle{ refl_comp.get(entt::const_handle{ changed_reg, e }) });
+    } else {
+      archive(std::string{ refl_comp.reflection().name().data() });
+    }
+  }
+  append(std::move(stream).str());
+}
+
+void
+Journal::append(std::string const& record)
+{
+  auto size = toLittleEndian(static_cast<std::uint64_t>(record.size()));
+  auto hash = toLittleEndian(hashBytes(record.data(), record.size()));
+
+  auto lock = std::lock_guard{ mutex };
+  pending.append(reinterpret_cast<char const*>(&size), sizeof(size));
+  pending.append(reinterpret_cast<char const*>(&hash), sizeof(hash));
+  pending.append(record);
+  appended += FRAME_HEADER_SIZE + record.size();
+}
+
+void
+Journal::commitLoop()
+{
+  auto lock = std::unique_lock{ mutex };
+  while (!stop || !pending.empty()) {
+    wake.wait_for(lock, options.commit_interval, [this] {
+      return stop || requested > durable;
+    });
+    if (pending.empty()) {
+      continue;
+    }
+
+    // everything appended before was committed already
+    auto batch = std::move(pending);
+    pending.clear();
+    auto end = durable + batch.size();
+
+    lock.unlock();
+    try {
+      writeAll(fd, batch);
+      if (::fdatasync(fd) != 0) {
+        throw std::runtime_error("Journal: failed to sync journal");
+      }
+    } catch (...) {
+      lock.lock();
+      error = std::current_exception();
+      committed.notify_all();
+      return;
+    }
+    lock.lock();
+
+    durable = end;
+    committed.notify_all();
+  }
+}
+
+Journal::Journal(entt::registry& in_reg,
+                 std::filesystem::path in_directory,
+                 ShouldSerializePred in_should_serialize,
+                 JournalOptions in_options)
+  : reg(in_reg)
+  , directory(std::move(in_directory))
+  , should_serialize(std::move(in_should_serialize))
+  , options(in_options)
+  , fd(-1)
+  , appended(0)
+  , durable(0)
+  , requested(0)
+  , stop(false)
+{
+  std::filesystem::create_directories(directory);
+
+  auto journal_path = directory / JOURNAL_FILE;
+  fd = ::open(journal_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Journal: failed to open " +
+                             journal_path.string());
+  }
+
+  try {
+    compact();
+
+    for (auto type : entt::resolve()) {
+      if (!type.func(CONNECT_CHANGES_FN_NAME)) {
+        continue;
+      }
+
+      auto refl_comp = ComponentReflection{ Reflection{ type } };
+      if (should_serialize(refl_comp.reflection().name().data())) {
+        refl_comp.connectChanges(reg, *this);
+        tracked.push_back(refl_comp);
+      }
+    }
+
+    // started last, since a joinable thread can't be left behind by throwing
+    committer = std::thread{ [this] { commitLoop(); } };
+  } catch (...) {
+    for (auto const& refl_comp : tracked) {
+      refl_comp.disconnectChanges(reg, *this);
+    }
+    ::close(fd);
+    throw;
+  }
+}
+
+Journal::~Journal()
+{
+  for (auto const& refl_comp : tracked) {
+    refl_comp.disconnectChanges(reg, *this);
+  }
+
+  {
+    auto lock = std::lock_guard{ mutex };
+    stop = true;
+  }
+  wake.notify_one();
+  committer.join();
+
+  ::close(fd);
+}
+
+#pragma endregion // journal
+
+} // namespace snapshot
@@ -0,0 +1,544 @@
+#include <entt_snapshot/Endian.hpp>
+#include <entt_snapshot/MappedSnapshot.hpp>
+#include <entt_snapshot/MemoryStream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace snapshot {
+
+namespace {
+
+template<typename T>
+void
+byteswapTable(T* table, std::size_t count)
+{
+  static_assert(sizeof(T) % sizeof(std::uint64_t) == 0);
+  byteswapColumn(reinterpret_cast<std::uint64_t*>(table),
+                 count * sizeof(T) / sizeof(std::uint64_t));
+}
+
+/**
+ * Whether count elements of element_size starting at offset fit into
+ * [0, limit), without overflowing.
+ * */
+bool
+fits(std::uint64_t offset,
+     std::uint64_t count,
+     std::uint64_t element_size,
+     std::uint64_t limit)
+{
+  return offset <= limit && count <= (limit - offset) / element_size;
+}
+
+/**
+ * Closes the file descriptor when going out of scope.
+ * */
+class FileDescriptor
+{
+public:
+  explicit FileDescriptor(int in_fd)
+    : fd(in_fd)
+  {}
+  FileDescriptor(FileDescriptor const&) = delete;
+  FileDescriptor& operator=(FileDescriptor const&) = delete;
+  ~FileDescriptor()
+  {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  int fd;
+};
+
+/**
+ * Unmaps the mapping when going out of scope, unless it was released.
+ * */
+class Mapping
+{
+public:
+  Mapping(void* in_data, std::size_t in_size)
+    : data(in_data)
+    , size(in_size)
+  {}
+  Mapping(Mapping const&) = delete;
+  Mapping& operator=(Mapping const&) = delete;
+  ~Mapping()
+  {
+    if (data != MAP_FAILED) {
+      ::munmap(data, size);
+    }
+  }
+
+  void* release() noexcept { return std::exchange(data, MAP_FAILED); }
+
+  void* data;
+  std::size_t size;
+};
+
+} // namespace
+
+#pragma region mapped_snapshot_writer
+
+void
+MappedSnapshotWriter::add(entt::entity e)
+{
+  entities.push_back(e);
+}
+
+void
+MappedSnapshotWriter::write(entt::entity e, Handle const& comp)
+{
+  auto stream = std::ostringstream{};
+  {
+    auto archive = cereal::PortableBinaryOutputArchive{
+      stream, cereal::PortableBinaryOutputArchive::Options::LittleEndian()
+    };
+    comp.doSave(archive);
+  }
+  auto bytes = std::move(stream).str();
+
+  records.push_back(Record{ .e = e,
+                            .type = typeIndex(comp.reflection().name()),
+                            .offset = offset,
+                            .size = bytes.size() });
+  entities.push_back(e);
+  writeBytes(bytes.data(), bytes.size());
+}
+
+void
+MappedSnapshotWriter::finish()
+{
+  auto trailer = detail::MappedTrailer{};
+  trailer.magic = detail::MAPPED_MAGIC;
+  trailer.version = detail::MAPPED_FORMAT_VERSION;
+  trailer.type_count = types.size();
+
+  trailer.types_offset = offset;
+  for (auto const& name : types) {
+    auto len = toLittleEndian(static_cast<std::uint32_t>(name.size()));
+    writeBytes(&len, sizeof(len));
+    writeBytes(name.data(), name.size());
+  }
+  pad();
+
+  std::sort(entities.begin(), entities.end());
+  entities.erase(std::unique(entities.begin(), entities.end()),
+                 entities.end());
+  std::stable_sort(
+    records.begin(), records.end(), [](Record const& lhs, Record const& rhs) {
+      return lhs.e < rhs.e;
+    });
+
+  trailer.entities_offset = offset;
+  trailer.entity_count = entities.size();
+  auto it = records.begin();
+  auto first_component = std::uint64_t{ 0 };
+  for (auto e : entities) {
+    auto last = std::find_if(
+      it, records.end(), [e](Record const& record) { return record.e != e; });
+
+    auto entry = detail::MappedEntity{
+      .e = static_cast<std::uint64_t>(entt::to_integral(e)),
+      .first_component = first_component,
+      .component_count = static_cast<std::uint64_t>(last - it)
+    };
+    first_component += entry.component_count;
+    it = last;
+
+    byteswapTable(&entry, NATIVE_LITTLE_ENDIAN ? 0 : 1);
+    writeBytes(&entry, sizeof(entry));
+  }
+
+  trailer.components_offset = offset;
+  trailer.component_count = records.size();
+  for (auto const& record : records) {
+    auto entry = detail::MappedComponent{ .offset = record.offset,
+                                          .size = record.size,
+                                          .type = record.type };
+    byteswapTable(&entry, NATIVE_LITTLE_ENDIAN ? 0 : 1);
+    writeBytes(&entry, sizeof(entry));
+  }
+
+  byteswapTable(&trailer, NATIVE_LITTLE_ENDIAN ? 0 : 1);
+  writeBytes(&trailer, sizeof(trailer));
+  stream.flush();
+}
+
+std::uint32_t
+MappedSnapshotWriter::typeIndex(std::string_view name)
+{
+  auto key = std::string{ name.data() };
+  auto it = type_indices.find(key);
+  if (it != type_indices.end()) {
+    return it->second;
+  }
+
+  auto index = static_cast<std::uint32_t>(types.size());
+  types.push_back(key);
+  type_indices.emplace(std::move(key), index);
+  return index;
+}
+
+void
+MappedSnapshotWriter::writeBytes(void const* data, std::size_t size)
+{
+  stream.write(static_cast<char const*>(data),
+               static_cast<std::streamsize>(size));
+  if (!stream) {
+    throw std::runtime_error("Failed to write mapped snapshot");
+  }
+  offset += size;
+}
+
+void
+MappedSnapshotWriter::pad()
+{
+  constexpr char zeros[8] = {};
+  if (auto rem = offset % 8; rem != 0) {
+    writeBytes(zeros, 8 - rem);
+  }
+}
+
+MappedSnapshotWriter::MappedSnapshotWriter(std::ostream& stream)
+  : stream(stream)
+  , offset(0)
+{}
+
+#pragma endregion // mapped_snapshot_writer
+
+#pragma region mapped_snapshot
+
+void
+MappedSnapshot::save(std::ostream& stream,
+                     entt::registry const& reg,
+                     ShouldSerializePred should_serialize)
+{
+  auto writer = MappedSnapshotWriter{ stream };
+
+  for (auto it = reg.data(), last = it + reg.size(); it != last; ++it) {
+    auto h = entt::const_handle{ reg, *it };
+    writer.add(h.entity());
+
+    h.visit([&writer, &h, &should_serialize](
+              entt::id_type type_id,
+              entt::basic_sparse_set<entt::entity> const& storage) {
+      auto refl_comp = ComponentReflection{ storage.type() };
+      if (refl_comp) {
+        auto comp_name = refl_comp.reflection().name();
+        if (should_serialize(comp_name.data())) {
+          writer.write(h.entity(), Handle{ refl_comp.get(h) });
+        }
+      }
+    });
+  }
+
+  writer.finish();
+}
+
+#pragma endregion // mapped_snapshot
+
+#pragma region snapshot_view
+
+std::size_t
+SnapshotView::size() const noexcept
+{
+  return trailer.entity_count;
+}
+
+entt::entity
+SnapshotView::entity(std::size_t i) const
+{
+  if (i >= trailer.entity_count) {
+    throw std::out_of_range("SnapshotView: entity index out of range");
+  }
+  return static_cast<entt::entity>(entity_table[i].e);
+}
+
+std::vector<entt::entity>
+SnapshotView::entities() const
+{
+  auto res = std::vector<entt::entity>{};
+  res.reserve(trailer.entity_count);
+  for (auto i = 0UL; i < trailer.entity_count; ++i) {
+    res.push_back(static_cast<entt::entity>(entity_table[i].e));
+  }
+  return res;
+}
+
+bool
+SnapshotView::contains(entt::entity e) const
+{
+  return find(e) != nullptr;
+}
+
+bool
+SnapshotView::contains(entt::entity e, Reflection const& refl) const
+{
+  return find(e, refl) != nullptr;
+}
+
+std::vector<Reflection>
+SnapshotView::components(entt::entity e) const
+{
+  auto res = std::vector<Reflection>{};
+
+  auto entry = find(e);
+  if (entry) {
+    auto first = component_table + entry->first_component;
+    auto last = first + entry->component_count;
+    for (auto it = first; it != last; ++it) {
+      if (it->type < types.size() && types[it->type]) {
+        res.push_back(types[it->type]);
+      }
+    }
+  }
+
+  return res;
+}
+
+entt::meta_any
+SnapshotView::get(entt::entity e, Reflection const& refl) const
+{
+  auto comp = find(e, refl);
+  if (!comp) {
+    throw std::runtime_error("SnapshotView: can't get component");
+  }
+
+  auto key = static_cast<std::uint64_t>(comp - component_table);
+  auto it = cache.find(key);
+  if (it == cache.end()) {
+    auto any = Any{ refl.type().construct() };
+    if (!any) {
+      throw std::runtime_error("Failed to construct any");
+    }
+
+    // payloads lie in front of the type table
+    if (!fits(comp->offset, comp->size, 1, trailer.types_offset)) {
+      throw std::runtime_error("SnapshotView: component exceeds payloads");
+    }
+    auto stream = detail::MemoryInputStream{ data + comp->offset, comp->size };
+    auto archive = cereal::PortableBinaryInputArchive{ stream };
+    any.doLoad(archive);
+
+    it = cache.emplace(key, std::move(*any)).first;
+  }
+
+  return it->second.as_ref();
+}
+
+void
+SnapshotView::clearCache()
+{
+  cache.clear();
+}
+
+std::vector<std::string_view>
+SnapshotView::componentNames(entt::entity e) const
+{
+  auto res = std::vector<std::string_view>{};
+
+  auto entry = find(e);
+  if (entry) {
+    auto first = component_table + entry->first_component;
+    auto last = first + entry->component_count;
+    for (auto it = first; it != last; ++it) {
+      if (it->type < type_names.size()) {
+        res.push_back(type_names[it->type]);
+      }
+    }
+  }
+
+  return res;
+}
+
+detail::MappedEntity const*
+SnapshotView::find(entt::entity e) const
+{
+  auto value = static_cast<std::uint64_t>(entt::to_integral(e));
+  auto last = entity_table + trailer.entity_count;
+  auto it = std::lower_bound(
+    entity_table,
+    last,
+    value,
+    [](detail::MappedEntity const& entry, std::uint64_t v) {
+      return entry.e < v;
+    });
+
+  if (it == last || it->e != value) {
+    return nullptr;
+  }
+  if (!fits(it->first_component,
+            it->component_count,
+            1,
+            trailer.component_count)) {
+    throw std::runtime_error("SnapshotView: entity exceeds component table");
+  }
+  return it;
+}
+
+detail::MappedComponent const*
+SnapshotView::find(entt::entity e, Reflection const& refl) const
+{
+  auto entry = find(e);
+  if (!entry) {
+    return nullptr;
+  }
+
+  auto first = component_table + entry->first_component;
+  auto last = first + entry->component_count;
+  for (auto it = first; it != last; ++it) {
+    if (it->type < types.size() && types[it->type] &&
+        types[it->type].type() == refl.type()) {
+      return it;
+    }
+  }
+  return nullptr;
+}
+
+SnapshotView::SnapshotView(std::filesystem::path const& path)
+  : data(nullptr)
+  , data_size(0)
+  , trailer()
+  , entity_table(nullptr)
+  , component_table(nullptr)
+{
+  // owned by holders until the view is complete, the destructor doesn't run
+  // if the constructor throws
+  auto file = FileDescriptor{ ::open(path.c_str(), O_RDONLY) };
+  if (file.fd < 0) {
+    throw std::runtime_error("SnapshotView: failed to open " + path.string());
+  }
+
+  struct stat st;
+  if (::fstat(file.fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(detail::MappedTrailer)) {
+    throw std::runtime_error("SnapshotView: invalid snapshot " +
+                             path.string());
+  }
+
+  data_size = static_cast<std::size_t>(st.st_size);
+  auto mapping = Mapping{
+    ::mmap(nullptr, data_size, PROT_READ, MAP_PRIVATE, file.fd, 0), data_size
+  };
+  if (mapping.data == MAP_FAILED) {
+    throw std::runtime_error("SnapshotView: failed to map " + path.string());
+  }
+  data = static_cast<char const*>(mapping.data);
+
+  std::memcpy(&trailer,
+              data + data_size - sizeof(detail::MappedTrailer),
+              sizeof(detail::MappedTrailer));
+  if constexpr (!NATIVE_LITTLE_ENDIAN) {
+    byteswapTable(&trailer, 1);
+  }
+  auto invalid = [&path] {
+    return std::runtime_error("SnapshotView: invalid snapshot " +
+                              path.string());
+  };
+
+  // tables lie in front of the trailer, payloads in front of the tables
+  auto tables_end = data_size - sizeof(detail::MappedTrailer);
+  if (trailer.magic != detail::MAPPED_MAGIC ||
+      trailer.version != detail::MAPPED_FORMAT_VERSION ||
+      trailer.entities_offset % 8 != 0 || trailer.components_offset % 8 != 0 ||
+      trailer.types_offset > trailer.entities_offset ||
+      !fits(trailer.entities_offset,
+            trailer.entity_count,
+            sizeof(detail::MappedEntity),
+            trailer.components_offset) ||
+      !fits(trailer.components_offset,
+            trailer.component_count,
+            sizeof(detail::MappedComponent),
+            tables_end)) {
+    throw invalid();
+  }
+
+  entity_table = reinterpret_cast<detail::MappedEntity const*>(
+    data + trailer.entities_offset);
+  component_table = reinterpret_cast<detail::MappedComponent const*>(
+    data + trailer.components_offset);
+
+  if constexpr (!NATIVE_LITTLE_ENDIAN) {
+    swapped_entities.assign(entity_table, entity_table + trailer.entity_count);
+    byteswapTable(swapped_entities.data(), swapped_entities.size());
+    entity_table = swapped_entities.data();
+
+    swapped_components.assign(component_table,
+                              component_table + trailer.component_count);
+    byteswapTable(swapped_components.data(), swapped_components.size());
+    component_table = swapped_components.data();
+  }
+
+  auto pos = trailer.types_offset;
+  for (auto i = 0UL; i < trailer.type_count; ++i) {
+    auto len = std::uint32_t{};
+    if (!fits(pos, sizeof(len), 1, trailer.entities_offset)) {
+      throw invalid();
+    }
+    std::memcpy(&len, data + pos, sizeof(len));
+    len = fromLittleEndian(len);
+    pos += sizeof(len);
+
+    if (!fits(pos, len, 1, trailer.entities_offset)) {
+      throw invalid();
+    }
+    auto name = std::string{ data + pos, len };
+    types.push_back(Reflection{ name });
+    type_names.push_back(std::move(name));
+    pos += len;
+  }
+
+  mapping.release();
+}
+
+SnapshotView::SnapshotView(SnapshotView&& other) noexcept
+  : data(std::exchange(other.data, nullptr))
+  , data_size(std::exchange(other.data_size, 0))
+  , trailer(other.trailer)
+  , entity_table(std::exchange(other.entity_table, nullptr))
+  , component_table(std::exchange(other.component_table, nullptr))
+  , swapped_entities(std::move(other.swapped_entities))
+  , swapped_components(std::move(other.swapped_components))
+  , types(std::move(other.types))
+  , type_names(std::move(other.type_names))
+  , cache(std::move(other.cache))
+{
+  other.trailer = detail::MappedTrailer{};
+}
+
+SnapshotView&
+SnapshotView::operator=(SnapshotView&& other) noexcept
+{
+  // other unmaps what was previously mapped by this
+  std::swap(data, other.data);
+  std::swap(data_size, other.data_size);
+  std::swap(trailer, other.trailer);
+  std::swap(entity_table, other.entity_table);
+  std::swap(component_table, other.component_table);
+  std::swap(swapped_entities, other.swapped_entities);
+  std::swap(swapped_components, other.swapped_components);
+  std::swap(types, other.types);
+  std::swap(type_names, other.type_names);
+  std::swap(cache, other.cache);
+  return *this;
+}
+
+SnapshotView::~SnapshotView()
+{
+  if (data) {
+    ::munmap(const_cast<char*>(data), data_size);
+  }
+}
+
+#pragma endregion // snapshot_view
+
+} // namespace snapshot
@@ -0,0 +1,297 @@
+#include <entt_snapshot/Profiler.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <sstream>
+#include <utility>
+
+namespace snapshot {
+
+namespace {
+
+bool
+slowerFirst(ProfileSample const& lhs, ProfileSample const& rhs)
+{
+  return lhs.nanoseconds > rhs.nanoseconds;
+}
+
+std::vector<ProfileSample>
+sorted(std::vector<ProfileSample> samples)
+{
+  std::sort(samples.begin(), samples.end(), slowerFirst);
+  return samples;
+}
+
+std::size_t
+opIndex(ProfileOp op)
+{
+  return static_cast<std::size_t>(op);
+}
+
+void
+reportSamples(std::ostream& stream,
+              char const* title,
+              std::vector<ProfileSample> const& samples)
+{
+  if (samples.empty()) {
+    return;
+  }
+
+  stream << "  " << title << ":\n";
+  for (auto const& sample : samples) {
+    stream << "    e=" << entt::to_integral(sample.e);
+    if (!sample.component.empty()) {
+      stream << ' ' << sample.component;
+    }
+    stream << ' ' << sample.nanoseconds << "ns " << sample.bytes << "B\n";
+  }
+}
+
+void
+reportHistogram(std::ostream& stream,
+                char const* title,
+                char const* unit,
+                ProfileHistogram const& histogram)
+{
+  stream << "  " << title << ": p50<=" << histogram.quantile(0.5) << unit
+         << " p90<=" << histogram.quantile(0.9) << unit
+         << " p99<=" << histogram.quantile(0.99) << unit
+         << " max=" << histogram.max() << unit << '\n';
+}
+
+} // namespace
+
+#pragma region profile_histogram
+
+void
+ProfileHistogram::add(std::uint64_t value)
+{
+  ++counts[std::bit_width(value)];
+  ++total_count;
+  total += value;
+  maximum = std::max(maximum, value);
+}
+
+std::uint64_t
+ProfileHistogram::quantile(double p) const
+{
+  if (total_count == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<std::uint64_t>(p * (total_count - 1)) + 1;
+  auto seen = std::uint64_t{ 0 };
+  for (auto i = 0UL; i < BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      auto upper = i < 64 ? (std::uint64_t{ 1 } << i) - 1 : maximum;
+      return std::min(upper, maximum);
+    }
+  }
+  return maximum;
+}
+
+#pragma endregion // profile_histogram
+
+#pragma region profiler
+
+std::vector<ProfileSample>
+Profiler::slowestEntities(ProfileOp op) const
+{
+  return sorted(stats[opIndex(op)].slowest_entities);
+}
+
+std::vector<ProfileSample>
+Profiler::slowestComponents(ProfileOp op) const
+{
+  return sorted(stats[opIndex(op)].slowest_components);
+}
+
+ProfileHistogram const&
+Profiler::entityTimes(ProfileOp op) const
+{
+  return stats[opIndex(op)].entity_times;
+}
+
+ProfileHistogram const&
+Profiler::entityBytes(ProfileOp op) const
+{
+  return stats[opIndex(op)].entity_bytes;
+}
+
+std::map<std::string, ProfileTotals, std::less<>> const&
+Profiler::componentTotals(ProfileOp op) const
+{
+  return stats[opIndex(op)].components;
+}
+
+std::string
+Profiler::report() const
+{
+  auto stream = std::ostringstream{};
+
+  for (auto op : { ProfileOp::encode, ProfileOp::decode }) {
+    auto const& op_stats = stats[opIndex(op)];
+    auto const& times = op_stats.entity_times;
+    auto const& sizes = op_stats.entity_bytes;
+    if (sizes.count() == 0) {
+      continue;
+    }
+
+    stream << (op == ProfileOp::encode ? "encode" : "decode") << ": "
+           << sizes.count() << " entities, " << sizes.sum() << "B, "
+           << times.count() << " timed, " << times.sum() << "ns\n";
+    reportHistogram(stream, "entity time", "ns", times);
+    reportHistogram(stream, "entity size", "B", sizes);
+
+    stream << "  components:\n";
+    for (auto const& [name, totals] : op_stats.components) {
+      stream << "    " << name << ' ' << totals.count << "x " << totals.bytes
+             << "B, " << totals.timed << " timed, " << totals.nanoseconds
+             << "ns\n";
+    }
+
+    reportSamples(stream, "slowest entities", slowestEntities(op));
+    reportSamples(stream, "slowest components", slowestComponents(op));
+  }
+
+  return std::move(stream).str();
+}
+
+void
+Profiler::reset()
+{
+  stats = {};
+  entity_count = 0;
+}
+
+void
+Profiler::recordEntity(ProfileOp op,
+                       std::optional<std::uint64_t> nanoseconds,
+                       std::uint64_t entity_bytes)
+{
+  auto& op_stats = stats[opIndex(op)];
+  op_stats.entity_bytes.add(entity_bytes);
+  if (!nanoseconds) {
+    return;
+  }
+
+  op_stats.entity_times.add(*nanoseconds);
+  keep(op_stats.slowest_entities,
+       ProfileSample{ .e = entity,
+                      .component = {},
+                      .nanoseconds = *nanoseconds,
+                      .bytes = entity_bytes });
+}
+
+void
+Profiler::recordComponent(ProfileOp op,
+                          std::string_view component,
+                          std::optional<std::uint64_t> nanoseconds,
+                          std::uint64_t component_bytes)
+{
+  auto& op_stats = stats[opIndex(op)];
+
+  auto it = op_stats.components.find(component);
+  if (it == op_stats.components.end()) {
+    it = op_stats.components
+           .emplace(std::string{ component }, ProfileTotals{})
+           .first;
+  }
+  ++it->second.count;
+  it->second.bytes += component_bytes;
+  if (!nanoseconds) {
+    return;
+  }
+  ++it->second.timed;
+  it->second.nanoseconds += *nanoseconds;
+
+  auto& heap = op_stats.slowest_components;
+  // avoids copying the name of samples which wouldn't be kept
+  if (heap.size() < options.top_k ||
+      (!heap.empty() && *nanoseconds > heap.front().nanoseconds)) {
+    keep(heap,
+         ProfileSample{ .e = entity,
+                        .component = std::string{ component },
+                        .nanoseconds = *nanoseconds,
+                        .bytes = component_bytes });
+  }
+}
+
+void
+Profiler::keep(std::vector<ProfileSample>& heap, ProfileSample&& sample) const
+{
+  if (options.top_k == 0) {
+    return;
+  }
+
+  // min-heap, the fastest kept sample is evicted first
+  if (heap.size() == options.top_k) {
+    if (sample.nanoseconds <= heap.front().nanoseconds) {
+      return;
+    }
+    std::pop_heap(heap.begin(), heap.end(), slowerFirst);
+    heap.back() = std::move(sample);
+  } else {
+    heap.push_back(std::move(sample));
+  }
+  std::push_heap(heap.begin(), heap.end(), slowerFirst);
+}
+
+Profiler::Profiler(ProfileOptions in_options)
+  : options(in_options)
+  , previous(current)
+  , entity_count(0)
+  , measuring(false)
+  , timing(false)
+  , entity(entt::null)
+  , bytes(0)
+{
+  options.sample_interval =
+    std::max(options.sample_interval, std::uint32_t{ 1 });
+  current = this;
+}
+
+Profiler::~Profiler()
+{
+  if (current == this) {
+    current = previous;
+    return;
+  }
+
+  // destroyed out of order, a newer profiler must not reinstate this one
+  for (auto newer = current; newer; newer = newer->previous) {
+    if (newer->previous == this) {
+      newer->previous = previous;
+      return;
+    }
+  }
+}
+
+#pragma endregion // profiler
+
+#pragma region profile_scope
+
+void
+detail::ProfileScope::end()
+{
+  auto nanoseconds = std::optional<std::uint64_t>{};
+  if (profiler->timing) {
+    nanoseconds = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+        .count());
+  }
+  auto scope_bytes = profiler->bytes - bytes;
+
+  if (component.empty()) {
+    profiler->measuring = false;
+    profiler->recordEntity(op, nanoseconds, scope_bytes);
+  } else {
+    profiler->recordComponent(op, component, nanoseconds, scope_bytes);
+  }
+}
+
+#pragma endregion // profile_scope
+
+} // namespace snapshot
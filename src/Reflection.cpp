@@ -93,6 +93,14 @@ ComponentReflection::emplace(entt::handle h, entt::meta_handle comp) const
   }
 }
 
+void
+ComponentReflection::emplaceSilent(entt::handle h, entt::meta_handle comp) const
+{
+  if (!comp->invoke(EMPLACE_SILENT_COMPONENT_FN_NAME, h, comp->data())) {
+    throw std::runtime_error("Failed to silently emplace component_any");
+  }
+}
+
 void
 ComponentReflection::emplace(entt::handle h) const
 {
@@ -105,6 +113,170 @@ ComponentReflection::emplace(entt::handle h) const
   emplace(h, comp);
 }
 
+bool
+ComponentReflection::hasListeners(entt::registry& reg) const
+{
+  auto res =
+    _reflection.type().invoke(HAS_LISTENERS_FN_NAME, entt::meta_handle{}, &reg);
+  if (!res) {
+    throw std::runtime_error("Failed to check for component listeners");
+  }
+  return res.cast<bool>();
+}
+
+bool
+ComponentReflection::isTag() const
+{
+  auto res = _reflection.type().invoke(IS_TAG_FN_NAME, entt::meta_handle{});
+  if (!res) {
+    throw std::runtime_error("Failed to check whether component is a tag");
+  }
+  return res.cast<bool>();
+}
+
+void
+ComponentReflection::insertTags(entt::registry& reg,
+                                std::vector<entt::entity> const& entities,
+                                bool silent) const
+{
+  if (!_reflection.type().invoke(
+        INSERT_TAGS_FN_NAME, entt::meta_handle{}, &reg, &entities, silent)) {
+    throw std::runtime_error("Failed to insert reflected tags");
+  }
+}
+
+std::uint64_t
+ComponentReflection::hash(entt::registry const& reg) const
+{
+  auto res =
+    _reflection.type().invoke(HASH_STORAGE_FN_NAME, entt::meta_handle{}, &reg);
+  if (!res) {
+    throw std::runtime_error("Failed to hash reflected component storage");
+  }
+  return res.cast<std::uint64_t>();
+}
+
+void
+ComponentReflection::sortAs(entt::registry& reg,
+                            std::vector<entt::entity> const& order) const
+{
+  if (!_reflection.type().invoke(
+        SORT_AS_FN_NAME, entt::meta_handle{}, &reg, &order)) {
+    throw std::runtime_error("Failed to sort reflected component storage");
+  }
+}
+
+void
+ComponentReflection::sortLike(
+  entt::registry& reg,
+  entt::basic_sparse_set<entt::entity> const& other) const
+{
+  if (!_reflection.type().invoke(
+        SORT_LIKE_FN_NAME, entt::meta_handle{}, &reg, &other)) {
+    throw std::runtime_error("Failed to sort reflected component storage");
+  }
+}
+
+std::uint32_t
+ComponentReflection::version() const
+{
+  auto res = _reflection.type().invoke(VERSION_FN_NAME, entt::meta_handle{});
+  if (!res) {
+    throw std::runtime_error("Failed to get version of reflected component");
+  }
+  return res.cast<std::uint32_t>();
+}
+
+void
+ComponentReflection::migrate(std::uint32_t from,
+                             std::vector<void*> const& instances) const
+{
+  if (!_reflection.type().invoke(
+        MIGRATE_FN_NAME, entt::meta_handle{}, from, version(), &instances)) {
+    throw std::runtime_error("Failed to migrate reflected component");
+  }
+}
+
+void
+ComponentReflection::migrate(entt::registry& reg,
+                             std::uint32_t from,
+                             std::vector<entt::entity> const& entities) const
+{
+  if (!_reflection.type().invoke(MIGRATE_STORAGE_FN_NAME,
+                                 entt::meta_handle{},
+                                 &reg,
+                                 from,
+                                 version(),
+                                 &entities)) {
+    throw std::runtime_error("Failed to migrate reflected component");
+  }
+}
+
+bool
+ComponentReflection::hasEntityRefs() const
+{
+  auto res =
+    _reflection.type().invoke(HAS_ENTITY_REFS_FN_NAME, entt::meta_handle{});
+  if (!res) {
+    throw std::runtime_error("Failed to check for entity references");
+  }
+  return res.cast<bool>();
+}
+
+void
+ComponentReflection::collectEntityRefs(entt::meta_handle comp,
+                                       std::vector<entt::entity>& out) const
+{
+  if (!comp->invoke(
+        COLLECT_ENTITY_REFS_FN_NAME, std::as_const(comp)->data(), &out)) {
+    throw std::runtime_error("Failed to collect entity references");
+  }
+}
+
+void
+ComponentReflection::remapEntityRefs(
+  std::vector<void*> const& instances,
+  std::unordered_map<entt::entity, entt::entity> const& mapping) const
+{
+  if (!_reflection.type().invoke(
+        REMAP_ENTITY_REFS_FN_NAME, entt::meta_handle{}, &instances, &mapping)) {
+    throw std::runtime_error("Failed to remap entity references");
+  }
+}
+
+void
+ComponentReflection::connectChanges(entt::registry& reg,
+                                    ChangeListener& listener) const
+{
+  if (!_reflection.type().invoke(
+        CONNECT_CHANGES_FN_NAME, entt::meta_handle{}, &reg, &listener)) {
+    throw std::runtime_error("Failed to connect to component changes");
+  }
+}
+
+void
+ComponentReflection::disconnectChanges(entt::registry& reg,
+                                       ChangeListener& listener) const
+{
+  if (!_reflection.type().invoke(
+        DISCONNECT_CHANGES_FN_NAME, entt::meta_handle{}, &reg, &listener)) {
+    throw std::runtime_error("Failed to disconnect from component changes");
+  }
+}
+
+std::unique_ptr<detail::StorageCopy>
+ComponentReflection::makeStorageCopy() const
+{
+  auto res =
+    _reflection.type().invoke(MAKE_STORAGE_COPY_FN_NAME, entt::meta_handle{});
+  if (!res) {
+    throw std::runtime_error("Failed to create storage copy");
+  }
+  return std::unique_ptr<detail::StorageCopy>{
+    res.cast<detail::StorageCopy*>()
+  };
+}
+
 ComponentReflection::ComponentReflection(Reflection in_reflection)
   : _reflection(in_reflection)
 {}
@@ -141,6 +313,16 @@ Any::doLoad(InputArchive archive)
   }
 }
 
+void
+Any::construct(std::string const& name)
+{
+  auto refl = Reflection{ name };
+  any = refl.type().construct();
+  if (!any) {
+    throw std::runtime_error("Failed to construct any");
+  }
+}
+
 Any::Any(entt::meta_any any)
   : any(any)
 {}
@@ -0,0 +1,281 @@
+#include <entt_snapshot/RollbackBuffer.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace snapshot {
+
+namespace {
+
+constexpr auto NPOS = static_cast<std::size_t>(-1);
+
+} // namespace
+
+#pragma region rollback_buffer
+
+void
+RollbackBuffer::capture(entt::registry const& reg, std::uint64_t frame)
+{
+  if (observed && observed != &reg) {
+    throw std::runtime_error("RollbackBuffer: observing another registry");
+  }
+  if (count > 0 && slots[slotIndex(count - 1)].frame >= frame) {
+    throw std::runtime_error("RollbackBuffer: frames have to increase");
+  }
+  if (count == slots.size()) {
+    evict();
+  }
+
+  auto index = slotIndex(count);
+  auto previous = count > 0 ? &slots[slotIndex(count - 1)] : nullptr;
+  auto& slot = slots[index];
+  slot.frame = frame;
+  slot.entities.assign(reg.data(), reg.data() + reg.size());
+  slot.released = reg.released();
+
+  for (auto i = 0UL; i < tracked.size(); ++i) {
+    if (previous && !changedSince(reg, *previous, i)) {
+      slot.owners[i] = previous->owners[i];
+    } else {
+      slot.storages[i]->capture(reg);
+      slot.owners[i] = index;
+    }
+  }
+  dirty.assign(dirty.size(), false);
+  ++count;
+}
+
+void
+RollbackBuffer::restore(entt::registry& reg, std::uint64_t frame)
+{
+  if (observed && observed != &reg) {
+    throw std::runtime_error("RollbackBuffer: observing another registry");
+  }
+  auto pos = position(frame);
+  if (pos == NPOS) {
+    throw std::runtime_error("RollbackBuffer: frame " + std::to_string(frame) +
+                             " isn't buffered");
+  }
+
+  auto const& slot = slots[slotIndex(pos)];
+  auto const& latest = slots[slotIndex(count - 1)];
+  auto same_entities =
+    reg.size() == slot.entities.size() && reg.released() == slot.released &&
+    std::equal(slot.entities.begin(), slot.entities.end(), reg.data());
+
+  if (!same_entities) {
+    restoreEntities(reg, slot);
+  }
+  for (auto i = 0UL; i < tracked.size(); ++i) {
+    // while observing, storages unchanged since the latest frame only differ
+    // from frames holding another copy
+    auto restore = observed ? slot.owners[i] != latest.owners[i] ||
+                                changedSince(reg, latest, i)
+                            : changedSince(reg, slot, i);
+    if (restore) {
+      slots[slot.owners[i]].storages[i]->restore(reg);
+    }
+  }
+  dirty.assign(dirty.size(), false);
+
+  count = pos + 1;
+}
+
+bool
+RollbackBuffer::contains(std::uint64_t frame) const
+{
+  return position(frame) != NPOS;
+}
+
+void
+RollbackBuffer::observe(entt::registry& reg)
+{
+  if (observed) {
+    throw std::runtime_error("RollbackBuffer: already observing a registry");
+  }
+
+  // nothing is known about changes made before
+  indices.clear();
+  dirty.assign(tracked.size(), true);
+  for (auto i = 0UL; i < tracked.size(); ++i) {
+    indices.emplace(tracked[i].reflection().type().id(), i);
+    tracked[i].connectChanges(reg, *this);
+  }
+  observed = &reg;
+}
+
+void
+RollbackBuffer::markDirty(entt::id_type type)
+{
+  if (auto it = indices.find(type); it != indices.end()) {
+    dirty[it->second] = true;
+  }
+}
+
+void
+RollbackBuffer::changed(entt::registry&,
+                        entt::entity,
+                        ComponentReflection const& refl_comp,
+                        ComponentChange)
+{
+  markDirty(refl_comp.reflection().type().id());
+}
+
+bool
+RollbackBuffer::changedSince(entt::registry const& reg,
+                             Slot const& slot,
+                             std::size_t i) const
+{
+  if (observed) {
+    return dirty[i];
+  }
+  return !slots[slot.owners[i]].storages[i]->equals(reg);
+}
+
+void
+RollbackBuffer::restoreEntities(entt::registry& reg, Slot const& slot)
+{
+  using traits = entt::entt_traits<entt::entity>;
+  auto const& saved = slot.entities;
+
+  // entities created since the frame, or recycled with another version
+  auto created = std::vector<entt::entity>{};
+  reg.each([&saved, &created](entt::entity e) {
+    auto id = entt::to_entity(e);
+    if (id >= saved.size() || saved[id] != e) {
+      created.push_back(e);
+    }
+  });
+  for (auto e : created) {
+    reg.destroy(e);
+  }
+
+  // every identifier is made alive, so that the free list can be rebuilt in
+  // the frame's order
+  auto released = reg.size() - reg.alive();
+  for (auto i = 0UL; i < released; ++i) {
+    reg.create();
+  }
+  while (reg.size() < saved.size()) {
+    reg.create();
+  }
+  for (auto id = 0UL; id < saved.size(); ++id) {
+    auto current = reg.data()[id];
+    if (entt::to_entity(saved[id]) == id && current != saved[id]) {
+      reg.destroy(current);
+      reg.create(saved[id]);
+    }
+  }
+
+  // the frame's free list, followed by identifiers created since, which are
+  // handed out as new ones
+  auto free_list = std::vector<entt::entity>{};
+  for (auto id = std::size_t{ entt::to_entity(slot.released) };
+       id < saved.size();
+       id = entt::to_entity(saved[id])) {
+    free_list.push_back(traits::construct(
+      static_cast<traits::entity_type>(id), entt::to_version(saved[id])));
+  }
+  for (auto id = saved.size(); id < reg.size(); ++id) {
+    free_list.push_back(
+      traits::construct(static_cast<traits::entity_type>(id), 0));
+  }
+
+  // destroying pushes to the front of the free list
+  for (auto it = free_list.rbegin(); it != free_list.rend(); ++it) {
+    reg.destroy(reg.data()[entt::to_entity(*it)], entt::to_version(*it));
+  }
+}
+
+std::size_t
+RollbackBuffer::slotIndex(std::size_t pos) const
+{
+  return (first + pos) % slots.size();
+}
+
+std::size_t
+RollbackBuffer::position(std::uint64_t frame) const
+{
+  for (auto pos = 0UL; pos < count; ++pos) {
+    if (slots[slotIndex(pos)].frame == frame) {
+      return pos;
+    }
+  }
+  return NPOS;
+}
+
+void
+RollbackBuffer::evict()
+{
+  auto oldest = first;
+  auto next = slotIndex(1);
+
+  // copies still referenced by newer frames move to the next slot
+  for (auto i = 0UL; count > 1 && i < tracked.size(); ++i) {
+    if (slots[next].owners[i] != oldest) {
+      continue;
+    }
+    std::swap(slots[oldest].storages[i], slots[next].storages[i]);
+    for (auto pos = 1UL; pos < count; ++pos) {
+      auto& slot = slots[slotIndex(pos)];
+      if (slot.owners[i] != oldest) {
+        break;
+      }
+      slot.owners[i] = next;
+    }
+  }
+
+  first = next;
+  --count;
+}
+
+RollbackBuffer::RollbackBuffer(std::size_t in_capacity,
+                               ShouldSerializePred should_serialize)
+  : observed(nullptr)
+  , first(0)
+  , count(0)
+{
+  if (in_capacity == 0) {
+    throw std::runtime_error("RollbackBuffer: capacity has to be positive");
+  }
+
+  for (auto type : entt::resolve()) {
+    if (!type.func(MAKE_STORAGE_COPY_FN_NAME)) {
+      continue;
+    }
+
+    auto refl_comp = ComponentReflection{ Reflection{ type } };
+    if (should_serialize(refl_comp.reflection().name().data())) {
+      tracked.push_back(refl_comp);
+    }
+  }
+
+  slots.resize(in_capacity);
+  for (auto& slot : slots) {
+    slot.owners.resize(tracked.size());
+    for (auto const& refl_comp : tracked) {
+      auto copy = refl_comp.makeStorageCopy();
+      if (!copy) {
+        throw std::runtime_error(
+          "RollbackBuffer: " + std::string{ refl_comp.reflection().name() } +
+          " isn't copy constructible");
+      }
+      slot.storages.push_back(std::move(copy));
+    }
+  }
+}
+
+RollbackBuffer::~RollbackBuffer()
+{
+  if (observed) {
+    for (auto const& refl_comp : tracked) {
+      refl_comp.disconnectChanges(*observed, *this);
+    }
+  }
+}
+
+#pragma endregion // rollback_buffer
+
+} // namespace snapshot
@@ -0,0 +1,185 @@
+#include <entt_snapshot/Schema.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+namespace snapshot {
+
+#pragma region schema
+
+std::size_t
+Schema::index(std::string_view name) const
+{
+  auto it = name_indices.find(std::string{ name });
+  return it != name_indices.end() ? it->second : npos;
+}
+
+void
+Schema::save(OutputArchive archive, entt::registry const& reg) const
+{
+  auto types = std::vector<detail::SchemaType>{};
+  types.reserve(entries.size());
+  for (auto const& entry : entries) {
+    types.push_back(
+      detail::SchemaType{ .name = entry.name, .version = entry.version });
+  }
+  archive(cereal::make_nvp("types", types));
+
+  // storages by schema index, looked up once instead of per entity
+  auto storages = std::vector<entt::basic_sparse_set<entt::entity> const*>(
+    entries.size(), nullptr);
+  for (auto&& [id, storage] : reg.storage()) {
+    auto i = typeIndex(id);
+    if (i != npos) {
+      storages[i] = &storage;
+    }
+  }
+
+  auto sz = reg.size();
+  archive(cereal::make_nvp("e_count", static_cast<std::uint64_t>(sz)));
+
+  // schema indices of each entity's components, gathered by iterating the
+  // storages instead of testing each entity against each storage
+  auto offsets = std::vector<std::size_t>(sz + 1, 0);
+  for (auto const* storage : storages) {
+    if (storage) {
+      for (auto e : *storage) {
+        ++offsets[entt::to_entity(e) + 1];
+      }
+    }
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  auto components = std::vector<std::size_t>(offsets.back());
+  auto next = std::vector<std::size_t>(offsets.begin(), offsets.end() - 1);
+  for (auto i = 0UL; i < storages.size(); ++i) {
+    if (storages[i]) {
+      for (auto e : *storages[i]) {
+        components[next[entt::to_entity(e)]++] = i;
+      }
+    }
+  }
+
+  for (auto id = 0UL; id < sz; ++id) {
+    auto e = reg.data()[id];
+    auto comps = std::span<std::size_t const>{ components.data() + offsets[id],
+                                               offsets[id + 1] - offsets[id] };
+
+    auto label = std::to_string(entt::to_integral(e));
+    archive(cereal::make_nvp(label,
+                             SavedEntity{ .schema = *this,
+                                          .reg = reg,
+                                          .e = e,
+                                          .components = comps }));
+  }
+
+  // storages in the order of the saved entities are loaded in that order
+  auto in_saved_order = [](entt::basic_sparse_set<entt::entity> const& s) {
+    return std::is_sorted(s.data(),
+                          s.data() + s.size(),
+                          [](entt::entity lhs, entt::entity rhs) {
+                            return entt::to_entity(lhs) < entt::to_entity(rhs);
+                          });
+  };
+
+  auto orders = std::vector<detail::SchemaOrder>{};
+  for (auto i = 0UL; i < storages.size(); ++i) {
+    if (!storages[i] || !entries[i].sort_as ||
+        in_saved_order(*storages[i])) {
+      continue;
+    }
+
+    auto& order = orders.emplace_back(detail::SchemaOrder{
+      .index = static_cast<std::uint32_t>(i), .entities = {} });
+    order.entities.reserve(storages[i]->size());
+    for (auto it = storages[i]->data(), last = it + storages[i]->size();
+         it != last;
+         ++it) {
+      order.entities.push_back(entt::to_integral(*it));
+    }
+  }
+  archive(cereal::make_nvp("storage_order", orders));
+}
+
+void
+Schema::load(InputArchive archive, entt::registry& reg) const
+{
+  auto types = std::vector<detail::SchemaType>{};
+  archive(types);
+
+  auto indices = std::vector<std::size_t>{};
+  indices.reserve(types.size());
+  auto pending =
+    std::vector<std::unique_ptr<detail::SchemaPending>>(entries.size());
+
+  for (auto const& type : types) {
+    auto i = index(type.name);
+    indices.push_back(i);
+
+    if (i != npos) {
+      auto const& entry = entries[i];
+      if (type.version < entry.version || entry.component->hasEntityRefs()) {
+        pending[i] = entry.component->makePending(type.version, entry.version);
+      }
+    }
+  }
+
+  auto sz = std::uint64_t{ 0 };
+  archive(sz);
+
+  auto entities = detail::EntityMapping{};
+  for (auto i = std::uint64_t{ 0 }; i < sz; ++i) {
+    auto loaded = LoadedEntity{ .schema = *this,
+                                .reg = reg,
+                                .indices = indices,
+                                .pending = pending,
+                                .entities = entities };
+    archive(loaded);
+  }
+
+  for (auto const& buffer : pending) {
+    if (buffer) {
+      buffer->emplace(reg, entities);
+    }
+  }
+
+  auto orders = std::vector<detail::SchemaOrder>{};
+  archive(orders);
+  auto order = std::vector<entt::entity>{};
+  for (auto const& saved : orders) {
+    auto i = translate(indices, saved.index);
+    if (i == npos || !entries[i].sort_as) {
+      continue;
+    }
+
+    order.clear();
+    for (auto sz_e : saved.entities) {
+      auto it = entities.find(static_cast<entt::entity>(sz_e));
+      if (it != entities.end()) {
+        order.push_back(it->second);
+      }
+    }
+    entries[i].sort_as(&reg, &order);
+  }
+}
+
+std::size_t
+Schema::typeIndex(entt::id_type type_hash) const
+{
+  auto it = type_indices.find(type_hash);
+  return it != type_indices.end() ? it->second : npos;
+}
+
+std::size_t
+Schema::translate(std::vector<std::size_t> const& indices,
+                  std::uint32_t saved_index) const
+{
+  if (saved_index >= indices.size()) {
+    throw std::runtime_error("Schema snapshot refers to an unknown type");
+  }
+  return indices[saved_index];
+}
+
+#pragma endregion // schema
+
+} // namespace snapshot
@@ -1,8 +1,103 @@
 #include <entt_snapshot/Reflection.hpp>
 #include <entt_snapshot/Snapshot.hpp>
 
+#include <unordered_set>
+
 namespace snapshot {
 
+namespace {
+
+/**
+ * Entities of the storage in its packed order, restricted to subset if
+ * passed. Only subset is scanned, not the whole storage.
+ * */
+std::vector<std::uint64_t>
+storageEntities(entt::basic_sparse_set<entt::entity> const& storage,
+                std::vector<entt::entity> const* subset)
+{
+  auto res = std::vector<std::uint64_t>{};
+
+  if (subset) {
+    auto contained = std::vector<entt::entity>{};
+    std::copy_if(subset->begin(),
+                 subset->end(),
+                 std::back_inserter(contained),
+                 [&storage](entt::entity e) { return storage.contains(e); });
+    std::sort(contained.begin(),
+              contained.end(),
+              [&storage](entt::entity lhs, entt::entity rhs) {
+                return storage.index(lhs) < storage.index(rhs);
+              });
+
+    res.reserve(contained.size());
+    for (auto e : contained) {
+      res.push_back(entt::to_integral(e));
+    }
+  } else {
+    res.reserve(storage.size());
+    for (auto it = storage.data(), last = it + storage.size(); it != last;
+         ++it) {
+      res.push_back(entt::to_integral(*it));
+    }
+  }
+
+  return res;
+}
+
+/**
+ * Whether the packed order of storage follows the order its entities are
+ * saved in, by ascending identifier or in the order of subset. Loading
+ * emplaces the components in that order, so such orders aren't saved.
+ * */
+bool
+inSavedOrder(entt::basic_sparse_set<entt::entity> const& storage,
+             std::vector<entt::entity> const* subset)
+{
+  if (!subset) {
+    return std::is_sorted(storage.data(),
+                          storage.data() + storage.size(),
+                          [](entt::entity lhs, entt::entity rhs) {
+                            return entt::to_entity(lhs) < entt::to_entity(rhs);
+                          });
+  }
+
+  auto next = 0UL;
+  for (auto e : *subset) {
+    if (!storage.contains(e)) {
+      continue;
+    }
+    auto index = storage.index(e);
+    if (index < next) {
+      return false;
+    }
+    next = index + 1;
+  }
+  return true;
+}
+
+} // namespace
+
+#pragma region load_signals
+
+void
+LoadSignals::publish(entt::id_type meta_id,
+                     entt::registry& reg,
+                     std::vector<entt::entity> const& entities)
+{
+  auto it = signals.find(meta_id);
+  if (it != signals.end()) {
+    it->second.publish(reg, entities);
+  }
+}
+
+LoadSignals::Signal&
+LoadSignals::signal(entt::id_type meta_id)
+{
+  return signals[meta_id];
+}
+
+#pragma endregion // load_signals
+
 #pragma region snapshot
 
 void
@@ -10,8 +105,14 @@ Snapshot::save(OutputArchive archive,
                entt::const_handle h,
                ShouldSerializePred should_serialize)
 {
-  archive(cereal::make_nvp("e_count", 1UL));
-  saveHandle(archive, h, should_serialize);
+  saveVersions(archive, h, should_serialize);
+  archive(cereal::make_nvp("e_count", std::uint64_t{ 1 }));
+  saveHandle(archive, h, should_serialize, false);
+
+  // tags are kept inline, the sections only make this loadable as registry
+  archive(cereal::make_nvp("tags", std::vector<detail::TagSet>{}));
+  archive(
+    cereal::make_nvp("storage_order", std::vector<detail::StorageOrder>{}));
 }
 
 void
@@ -19,32 +120,116 @@ Snapshot::save(OutputArchive archive,
                entt::registry const& reg,
                ShouldSerializePred should_serialize)
 {
+  saveVersions(archive, reg, should_serialize);
+
   auto sz = reg.size();
 
-  archive(cereal::make_nvp("e_count", sz));
+  archive(cereal::make_nvp("e_count", static_cast<std::uint64_t>(sz)));
 
   for (auto it = reg.data(), last = it + sz; it != last; ++it) {
     auto h = entt::const_handle{ reg, *it };
-    saveHandle(archive, h, should_serialize);
+    saveHandle(archive, h, should_serialize, true);
+  }
+
+  saveTags(archive, reg, should_serialize, nullptr);
+  saveStorageOrder(archive, reg, should_serialize, nullptr);
+}
+
+void
+Snapshot::save(OutputArchive archive,
+               entt::registry const& reg,
+               std::vector<entt::entity> const& roots,
+               ShouldSerializePred should_serialize)
+{
+  auto entities = closure(reg, roots, should_serialize);
+
+  saveVersions(archive, reg, should_serialize);
+  archive(
+    cereal::make_nvp("e_count", static_cast<std::uint64_t>(entities.size())));
+
+  for (auto e : entities) {
+    saveHandle(archive, entt::const_handle{ reg, e }, should_serialize, true);
+  }
+
+  saveTags(archive, reg, should_serialize, &entities);
+  saveStorageOrder(archive, reg, should_serialize, &entities);
+}
+
+std::vector<entt::entity>
+Snapshot::closure(entt::registry const& reg,
+                  std::vector<entt::entity> const& roots,
+                  ShouldSerializePred const& should_serialize)
+{
+  auto res = std::vector<entt::entity>{};
+  auto visited = std::unordered_set<entt::entity>{};
+  auto enqueue = [&reg, &res, &visited](entt::entity e) {
+    if (reg.valid(e) && visited.insert(e).second) {
+      res.push_back(e);
+    }
+  };
+
+  for (auto e : roots) {
+    enqueue(e);
+  }
+
+  // whether components of a storage are followed, by storage id
+  auto follow = std::unordered_map<entt::id_type, bool>{};
+  auto refs = std::vector<entt::entity>{};
+
+  for (auto i = 0UL; i < res.size(); ++i) {
+    auto h = entt::const_handle{ reg, res[i] };
+
+    refs.clear();
+    h.visit([&h, &follow, &refs, &should_serialize](
+              entt::id_type type_id,
+              entt::basic_sparse_set<entt::entity> const& storage) {
+      auto refl_comp = ComponentReflection{ storage.type() };
+      if (!refl_comp) {
+        return;
+      }
+
+      auto it = follow.find(type_id);
+      if (it == follow.end()) {
+        auto comp_name = refl_comp.reflection().name();
+        it = follow
+               .emplace(type_id,
+                        refl_comp.hasEntityRefs() &&
+                          should_serialize(comp_name.data()))
+               .first;
+      }
+
+      if (it->second) {
+        auto comp = refl_comp.get(h);
+        refl_comp.collectEntityRefs(comp, refs);
+      }
+    });
+
+    for (auto e : refs) {
+      enqueue(e);
+    }
   }
+
+  return res;
 }
 
 void
 Snapshot::saveHandle(OutputArchive& archive,
                      entt::const_handle h,
-                     ShouldSerializePred should_serialize)
+                     ShouldSerializePred should_serialize,
+                     bool skip_tags)
 {
   auto e = h.entity();
+  auto scope = detail::ProfileScope{ ProfileOp::encode, e };
 
   auto e_serial =
     detail::SerializeHandleEntity{ .e = e,
                                    .components = std::vector<Handle>{} };
 
-  h.visit([&e_serial, &h, &should_serialize](
+  h.visit([&e_serial, &h, &should_serialize, skip_tags](
             entt::id_type type_id,
             entt::basic_sparse_set<entt::entity> const& storage) {
     auto refl_comp = ComponentReflection{ storage.type() };
-    if (refl_comp) {
+    if (refl_comp && !(skip_tags && refl_comp.isTag())) {
 
       auto comp_name = refl_comp.reflection().name();
       if (should_serialize(comp_name.data())) {
@@ -57,6 +242,101 @@ Snapshot::saveHandle(OutputArchive& archive,
   archive(cereal::make_nvp(label, e_serial));
 }
 
+void
+Snapshot::saveTags(OutputArchive& archive,
+                   entt::registry const& reg,
+                   ShouldSerializePred const& should_serialize,
+                   std::vector<entt::entity> const* subset)
+{
+  auto tags = std::vector<detail::TagSet>{};
+
+  for (auto&& [id, storage] : reg.storage()) {
+    auto refl_comp = ComponentReflection{ storage.type() };
+    if (!refl_comp || !refl_comp.isTag()) {
+      continue;
+    }
+
+    auto comp_name = refl_comp.reflection().name();
+    if (should_serialize(comp_name.data())) {
+      auto& tag = tags.emplace_back(
+        detail::TagSet{ .name = std::string{ comp_name.data() },
+                        .runs = {},
+                        .versions = {} });
+      tag.assign(storageEntities(storage, subset));
+    }
+  }
+
+  archive(cereal::make_nvp("tags", tags));
+}
+
+void
+Snapshot::saveStorageOrder(OutputArchive& archive,
+                           entt::registry const& reg,
+                           ShouldSerializePred const& should_serialize,
+                           std::vector<entt::entity> const* subset)
+{
+  auto orders = std::vector<detail::StorageOrder>{};
+
+  for (auto&& [id, storage] : reg.storage()) {
+    // tags are restored as sets, their order is never kept
+    auto refl_comp = ComponentReflection{ storage.type() };
+    if (!refl_comp || refl_comp.isTag()) {
+      continue;
+    }
+
+    auto comp_name = refl_comp.reflection().name();
+    if (should_serialize(comp_name.data()) && !inSavedOrder(storage, subset)) {
+      orders.emplace_back(
+        detail::StorageOrder{ .name = std::string{ comp_name.data() },
+                              .entities = storageEntities(storage, subset) });
+    }
+  }
+
+  archive(cereal::make_nvp("storage_order", orders));
+}
+
+void
+Snapshot::saveVersions(OutputArchive& archive,
+                       entt::registry const& reg,
+                       ShouldSerializePred const& should_serialize)
+{
+  auto versions = detail::ComponentVersions{};
+
+  for (auto&& [id, storage] : reg.storage()) {
+    auto refl_comp = ComponentReflection{ storage.type() };
+    if (refl_comp) {
+      auto comp_name = refl_comp.reflection().name();
+      if (should_serialize(comp_name.data())) {
+        versions.emplace(comp_name.data(), refl_comp.version());
+      }
+    }
+  }
+
+  archive(cereal::make_nvp("versions", versions));
+}
+
+void
+Snapshot::saveVersions(OutputArchive& archive,
+                       entt::const_handle h,
+                       ShouldSerializePred const& should_serialize)
+{
+  auto versions = detail::ComponentVersions{};
+
+  h.visit([&versions, &should_serialize](
+            entt::id_type type_id,
+            entt::basic_sparse_set<entt::entity> const& storage) {
+    auto refl_comp = ComponentReflection{ storage.type() };
+    if (refl_comp) {
+      auto comp_name = refl_comp.reflection().name();
+      if (should_serialize(comp_name.data())) {
+        versions.emplace(comp_name.data(), refl_comp.version());
+      }
+    }
+  });
+
+  archive(cereal::make_nvp("versions", versions));
+}
+
 #pragma endregion // snapshot
 
 #pragma region snapshot_loader
@@ -66,12 +346,17 @@ SnapshotLoader::load(InputArchive archive,
                      entt::handle h,
                      ShouldSerializePred should_serialize)
 {
+  auto context = detail::LoadContext{};
+  loadVersions(archive, context);
+
   {
-    auto sz = 0UL;
+    auto sz = std::uint64_t{ 0 };
     archive(sz);
   }
 
-  loadHandle(archive, h, should_serialize);
+  context.remap_entity_refs = false;
+  loadHandle(archive, h, should_serialize, context);
+  emplacePending(*h.registry(), context);
 }
 
 void
@@ -79,46 +364,239 @@ SnapshotLoader::load(InputArchive archive,
                      entt::registry& reg,
                      ShouldSerializePred should_serialize)
 {
-  auto sz = 0UL;
+  load(archive, reg, should_serialize, ShouldLoadEntity::tautology());
+}
+
+void
+SnapshotLoader::load(InputArchive archive,
+                     entt::registry& reg,
+                     ShouldSerializePred should_serialize,
+                     ShouldLoadEntityPred should_load_entity)
+{
+  auto context = detail::LoadContext{};
+  loadRegistry(archive, reg, should_serialize, should_load_entity, context);
+}
+
+void
+SnapshotLoader::load(InputArchive archive,
+                     entt::registry& reg,
+                     ShouldSerializePred should_serialize,
+                     ShouldLoadEntityPred should_load_entity,
+                     LoadSignals& signals)
+{
+  // listeners would miss silently loaded components, and notifying them per
+  // instance besides the batch would notify twice
+  auto loaded_types = std::vector<ComponentReflection>{};
+  for (auto&& [id, storage] : reg.storage()) {
+    auto refl_comp = ComponentReflection{ storage.type() };
+    if (refl_comp && should_serialize(refl_comp.reflection().name().data())) {
+      loaded_types.push_back(refl_comp);
+    }
+  }
+  for (auto const& refl_comp : loaded_types) {
+    if (refl_comp.hasListeners(reg)) {
+      throw std::runtime_error(
+        "SnapshotLoader: " + std::string{ refl_comp.reflection().name() } +
+        " has listeners, its signals can't be deferred");
+    }
+  }
+
+  auto context = detail::LoadContext{};
+  context.signals = &signals;
+  loadRegistry(archive, reg, should_serialize, should_load_entity, context);
+
+  for (auto const& [id, entities] : context.emplaced) {
+    signals.publish(id, reg, entities);
+  }
+}
+
+void
+SnapshotLoader::coSort(entt::registry& reg,
+                       std::vector<std::string> const& names)
+{
+  if (names.empty()) {
+    return;
+  }
+
+  auto lead = Reflection{ names.front() };
+  if (!lead) {
+    throw std::runtime_error("coSort: component isn't reflected");
+  }
+
+  for (auto&& [id, storage] : reg.storage()) {
+    if (Reflection{ storage.type() }.type() != lead.type()) {
+      continue;
+    }
+
+    for (auto it = names.begin() + 1; it != names.end(); ++it) {
+      auto refl_comp = ComponentReflection{ Reflection{ *it } };
+      if (!refl_comp) {
+        throw std::runtime_error("coSort: component isn't reflected");
+      }
+      refl_comp.sortLike(reg, storage);
+    }
+    break;
+  }
+}
+
+void
+SnapshotLoader::loadRegistry(InputArchive archive,
+                             entt::registry& reg,
+                             ShouldSerializePred const& should_serialize,
+                             ShouldLoadEntityPred const& should_load_entity,
+                             detail::LoadContext& context)
+{
+  loadVersions(archive, context);
+
+  auto sz = std::uint64_t{ 0 };
   archive(sz);
 
-  for (auto i = 0UL; i < sz; ++i) {
-    loadHandle(archive, reg, should_serialize);
+  for (auto i = std::uint64_t{ 0 }; i < sz; ++i) {
+    loadHandle(archive, reg, should_serialize, should_load_entity, context);
   }
+
+  loadTags(archive, reg, should_serialize, context);
+  emplacePending(reg, context);
+  loadStorageOrder(archive, reg, should_serialize, context);
 }
 
 void
 SnapshotLoader::loadHandle(InputArchive archive,
                            entt::registry& reg,
-                           ShouldSerializePred should_serialize)
+                           ShouldSerializePred const& should_serialize,
+                           ShouldLoadEntityPred const& should_load_entity,
+                           detail::LoadContext& context)
 {
-  auto serial_e = detail::SerializeEntity{};
+  auto serial_e =
+    detail::SerializeEntity{ .e = entt::null,
+                             .components = {},
+                             .should_serialize = should_serialize,
+                             .should_load_entity = should_load_entity };
   archive(serial_e);
+  if (serial_e.skipped) {
+    return;
+  }
 
   auto h = entt::handle{ reg, reg.create(serial_e.e) };
+  context.entities.emplace(serial_e.e, h.entity());
 
   for (auto& comp : serial_e.components) {
-    auto comp_name = comp.reflection().name().data();
-    if (should_serialize(comp_name)) {
-      comp.componentReflection().emplace(h, *comp);
+    context.load(h, comp);
+  }
+}
+
+void
+SnapshotLoader::loadTags(InputArchive archive,
+                         entt::registry& reg,
+                         ShouldSerializePred const& should_serialize,
+                         detail::LoadContext& context)
+{
+  auto tags = std::vector<detail::TagSet>{};
+  archive(tags);
+
+  auto entities = std::vector<entt::entity>{};
+  for (auto const& tag : tags) {
+    auto refl_comp = ComponentReflection{ Reflection{ tag.name } };
+    if (!refl_comp || !should_serialize(tag.name.c_str())) {
+      continue;
+    }
+
+    entities.clear();
+    tag.each([&entities, &context](entt::entity saved) {
+      auto loaded = context.translate(saved);
+      if (loaded != entt::null) {
+        entities.push_back(loaded);
+      }
+    });
+    refl_comp.insertTags(reg, entities, context.signals != nullptr);
+
+    if (context.signals) {
+      auto& emplaced = context.emplaced[refl_comp.reflection().type().id()];
+      emplaced.insert(emplaced.end(), entities.begin(), entities.end());
     }
   }
 }
 
+void
+SnapshotLoader::loadStorageOrder(InputArchive archive,
+                                 entt::registry& reg,
+                                 ShouldSerializePred const& should_serialize,
+                                 detail::LoadContext const& context)
+{
+  auto orders = std::vector<detail::StorageOrder>{};
+  archive(orders);
+
+  auto order = std::vector<entt::entity>{};
+  for (auto const& saved : orders) {
+    auto refl_comp = ComponentReflection{ Reflection{ saved.name } };
+    if (!refl_comp || !should_serialize(saved.name.c_str())) {
+      continue;
+    }
+
+    order.clear();
+    for (auto e : saved.entities) {
+      auto loaded = context.translate(static_cast<entt::entity>(e));
+      if (loaded != entt::null) {
+        order.push_back(loaded);
+      }
+    }
+    refl_comp.sortAs(reg, order);
+  }
+}
+
 void
 SnapshotLoader::loadHandle(InputArchive archive,
                            entt::handle h,
-                           ShouldSerializePred should_serialize)
+                           ShouldSerializePred const& should_serialize,
+                           detail::LoadContext& context)
 {
-  auto serial_e = detail::SerializeEntity{};
+  auto should_load_entity = ShouldLoadEntity::tautology();
+  auto serial_e =
+    detail::SerializeEntity{ .e = entt::null,
+                             .components = {},
+                             .should_serialize = should_serialize,
+                             .should_load_entity = should_load_entity };
   archive(serial_e);
 
   for (auto& comp : serial_e.components) {
-    auto comp_name = comp.reflection().name().data();
+    context.load(h, comp);
+  }
+}
 
-    if (should_serialize(comp_name)) {
-      comp.componentReflection().emplace(h, *comp);
+void
+SnapshotLoader::loadVersions(InputArchive archive, detail::LoadContext& context)
+{
+  auto versions = detail::ComponentVersions{};
+  archive(versions);
+  context.setVersions(versions);
+}
+
+void
+SnapshotLoader::emplacePending(entt::registry& reg,
+                               detail::LoadContext& context)
+{
+  auto instances = std::vector<void*>{};
+  for (auto& [id, pending] : context.pending) {
+    auto refl_comp = ComponentReflection{ Reflection{ id } };
+
+    instances.clear();
+    for (auto& comp : pending.components) {
+      instances.push_back((*comp).data());
+    }
+
+    if (context.remap_entity_refs && refl_comp.hasEntityRefs()) {
+      refl_comp.remapEntityRefs(instances, context.entities);
+    }
+    if (auto it = context.outdated.find(id); it != context.outdated.end()) {
+      refl_comp.migrate(it->second, instances);
+    }
+
+    for (auto i = 0UL; i < pending.entities.size(); ++i) {
+      context.emplace(entt::handle{ reg, pending.entities[i] },
+                      pending.components[i]);
     }
   }
+  context.pending.clear();
 }
-} // namespace snapshot
\ No newline at end of file
+
+} // namespace snapshot
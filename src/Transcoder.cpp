@@ -0,0 +1,653 @@
+#include <entt_snapshot/Transcoder.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace snapshot {
+
+namespace {
+
+constexpr auto USAGE =
+  "usage: entt_snapshot_transcode --from FORMAT --to FORMAT [--jobs N]\n"
+  "                               [--only NAME,...] IN OUT [IN OUT ...]\n"
+  "FORMAT is one of json, binary, portable, mapped\n";
+
+template<typename Func>
+void
+withInput(std::filesystem::path const& path, SnapshotFormat format, Func&& func)
+{
+  auto stream = std::ifstream{ path, std::ios::binary };
+  if (!stream) {
+    throw std::runtime_error("Failed to open " + path.string());
+  }
+
+  switch (format) {
+    case SnapshotFormat::json: {
+      auto archive = cereal::JSONInputArchive{ stream };
+      func(InputArchive{ archive });
+      break;
+    }
+    case SnapshotFormat::binary: {
+      auto archive = cereal::BinaryInputArchive{ stream };
+      func(InputArchive{ archive });
+      break;
+    }
+    case SnapshotFormat::portable: {
+      auto archive = cereal::PortableBinaryInputArchive{ stream };
+      func(InputArchive{ archive });
+      break;
+    }
+    case SnapshotFormat::mapped:
+      throw std::runtime_error("Mapped snapshots aren't read via archives");
+  }
+}
+
+template<typename Func>
+void
+withOutput(std::filesystem::path const& path,
+           SnapshotFormat format,
+           Func&& func)
+{
+  auto stream = std::ofstream{ path, std::ios::binary | std::ios::trunc };
+  if (!stream) {
+    throw std::runtime_error("Failed to open " + path.string());
+  }
+
+  switch (format) {
+    case SnapshotFormat::json: {
+      auto archive = cereal::JSONOutputArchive{ stream };
+      func(OutputArchive{ archive });
+      break;
+    }
+    case SnapshotFormat::binary: {
+      auto archive = cereal::BinaryOutputArchive{ stream };
+      func(OutputArchive{ archive });
+      break;
+    }
+    case SnapshotFormat::portable: {
+      auto archive = cereal::PortableBinaryOutputArchive{
+        stream, cereal::PortableBinaryOutputArchive::Options::LittleEndian()
+      };
+      func(OutputArchive{ archive });
+      break;
+    }
+    case SnapshotFormat::mapped:
+      throw std::runtime_error("Mapped snapshots aren't written via archives");
+  }
+}
+
+/**
+ * Opens archives of the same binary format, whose component records can be
+ * copied between each other.
+ * */
+template<typename Func>
+void
+withRecordArchives(std::filesystem::path const& in,
+                   std::filesystem::path const& out,
+                   SnapshotFormat format,
+                   Func&& func)
+{
+  auto in_stream = std::ifstream{ in, std::ios::binary };
+  if (!in_stream) {
+    throw std::runtime_error("Failed to open " + in.string());
+  }
+  auto out_stream = std::ofstream{ out, std::ios::binary | std::ios::trunc };
+  if (!out_stream) {
+    throw std::runtime_error("Failed to open " + out.string());
+  }
+
+  if (format == SnapshotFormat::binary) {
+    auto in_archive = cereal::BinaryInputArchive{ in_stream };
+    auto out_archive = cereal::BinaryOutputArchive{ out_stream };
+    func(in_archive, out_archive);
+  } else {
+    auto in_archive = cereal::PortableBinaryInputArchive{ in_stream };
+    auto out_archive = cereal::PortableBinaryOutputArchive{
+      out_stream, cereal::PortableBinaryOutputArchive::Options::LittleEndian()
+    };
+    func(in_archive, out_archive);
+  }
+}
+
+ShouldSerializePred
+onlyNames(std::string const& list)
+{
+  auto names = std::set<std::string, std::less<>>{};
+  auto stream = std::istringstream{ list };
+  for (auto name = std::string{}; std::getline(stream, name, ',');) {
+    names.insert(name);
+  }
+
+  return [names = std::move(names)](char const* name) {
+    return names.contains(std::string_view{ name });
+  };
+}
+
+/**
+ * Reads the saved versions, the transcoded snapshot contains the components
+ * migrated to their reflected versions.
+ * */
+detail::ComponentVersions
+upgradeVersions(InputArchive& in, detail::LoadContext& context)
+{
+  auto versions = detail::ComponentVersions{};
+  in(versions);
+  context.setVersions(versions);
+
+  for (auto& [name, version] : versions) {
+    auto refl_comp = ComponentReflection{ Reflection{ name } };
+    if (refl_comp) {
+      version = std::max(version, refl_comp.version());
+    }
+  }
+  return versions;
+}
+
+std::vector<detail::TagSet>
+loadTags(InputArchive& in, ShouldSerializePred const& should_serialize)
+{
+  auto tags = std::vector<detail::TagSet>{};
+  in(tags);
+  std::erase_if(tags, [&should_serialize](auto const& tag) {
+    return !should_serialize(tag.name.c_str());
+  });
+  return tags;
+}
+
+/**
+ * Reflections of the entity's components accepted by should_serialize.
+ * Throws for accepted components which aren't reflected, like decoding them
+ * from archives does.
+ * */
+std::vector<Reflection>
+viewComponents(SnapshotView const& view,
+               entt::entity e,
+               ShouldSerializePred const& should_serialize)
+{
+  auto res = std::vector<Reflection>{};
+  for (auto name : view.componentNames(e)) {
+    auto name_str = std::string{ name };
+    if (!should_serialize(name_str.c_str())) {
+      continue;
+    }
+
+    auto refl = Reflection{ name_str };
+    if (!refl) {
+      throw std::runtime_error("Transcoder: component " + name_str +
+                               " isn't reflected");
+    }
+    res.push_back(refl);
+  }
+  return res;
+}
+
+bool
+hasReflectedComponents()
+{
+  for (auto type : entt::resolve()) {
+    if (type.func(SAVE_FN_NAME)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Entities decoded at once, so outdated components are migrated with one
+ * call per type and chunk while memory stays bounded.
+ * */
+constexpr auto CHUNK_SIZE = 256UL;
+
+struct DecodedEntity
+{
+  entt::entity e;
+  std::vector<Any> components;
+};
+
+void
+migrate(std::vector<DecodedEntity>& chunk, detail::LoadContext const& context)
+{
+  if (context.outdated.empty()) {
+    return;
+  }
+
+  auto instances = std::map<entt::id_type, std::vector<void*>>{};
+  for (auto& decoded : chunk) {
+    for (auto& comp : decoded.components) {
+      auto id = comp.reflection().type().id();
+      if (context.outdated.contains(id)) {
+        instances[id].push_back((*comp).data());
+      }
+    }
+  }
+
+  for (auto const& [id, comps] : instances) {
+    ComponentReflection{ Reflection{ id } }.migrate(context.outdated.at(id),
+                                                    comps);
+  }
+}
+
+/**
+ * Decodes the entities of in chunk by chunk, migrates them and passes each
+ * to write.
+ * */
+template<typename Write>
+void
+transcodeEntities(InputArchive& in,
+                  std::uint64_t count,
+                  ShouldSerializePred const& should_serialize,
+                  detail::LoadContext const& context,
+                  Write&& write)
+{
+  auto should_load_entity = ShouldLoadEntity::tautology();
+  auto chunk = std::vector<DecodedEntity>{};
+  chunk.reserve(std::min<std::uint64_t>(count, CHUNK_SIZE));
+
+  for (auto i = std::uint64_t{ 0 }; i < count; ++i) {
+    auto serial_e =
+      detail::SerializeEntity{ .e = entt::null,
+                               .components = {},
+                               .should_serialize = should_serialize,
+                               .should_load_entity = should_load_entity };
+    in(serial_e);
+    chunk.push_back(DecodedEntity{ .e = serial_e.e,
+                                   .components =
+                                     std::move(serial_e.components) });
+
+    if (chunk.size() == CHUNK_SIZE || i + 1 == count) {
+      migrate(chunk, context);
+      for (auto& decoded : chunk) {
+        write(decoded);
+      }
+      chunk.clear();
+    }
+  }
+}
+
+void
+writeDecoded(OutputArchive& out, DecodedEntity& decoded)
+{
+  auto e_serial =
+    detail::SerializeHandleEntity{ .e = decoded.e,
+                                   .components = std::vector<Handle>{} };
+  for (auto& comp : decoded.components) {
+    e_serial.components.push_back(Handle{ *comp });
+  }
+
+  auto label = std::to_string(entt::to_integral(decoded.e));
+  out(cereal::make_nvp(label, e_serial));
+}
+
+/**
+ * Copies the entities' component records without decoding them, dropping
+ * the records rejected by should_serialize.
+ * */
+template<typename In, typename Out>
+void
+copyRecords(In& in,
+            Out& out,
+            std::uint64_t count,
+            ShouldSerializePred const& should_serialize)
+{
+  struct Record
+  {
+    std::string name;
+    std::string bytes;
+  };
+  // reused across entities
+  auto records = std::vector<Record>{};
+
+  for (auto i = std::uint64_t{ 0 }; i < count; ++i) {
+    auto sz_e = std::uint64_t{ 0 };
+    in(sz_e);
+    out(sz_e);
+
+    auto size = cereal::size_type{ 0 };
+    in(cereal::make_size_tag(size));
+    auto kept = 0UL;
+    for (auto j = cereal::size_type{ 0 }; j < size; ++j) {
+      auto has_any = false;
+      in(has_any);
+      if (!has_any) {
+        continue;
+      }
+
+      if (kept == records.size()) {
+        records.emplace_back();
+      }
+      auto& record = records[kept];
+      in(record.name);
+      auto record_size = cereal::size_type{ 0 };
+      in(cereal::make_size_tag(record_size));
+      record.bytes.resize(record_size);
+      in(cereal::binary_data(record.bytes.data(), record_size));
+
+      if (should_serialize(record.name.c_str())) {
+        ++kept;
+      }
+    }
+
+    auto kept_size = static_cast<cereal::size_type>(kept);
+    out(cereal::make_size_tag(kept_size));
+    for (auto j = 0UL; j < kept; ++j) {
+      auto const& record = records[j];
+      auto record_size = static_cast<cereal::size_type>(record.bytes.size());
+      out(true, record.name, cereal::make_size_tag(record_size));
+      out(cereal::binary_data(record.bytes.data(), record.bytes.size()));
+    }
+  }
+}
+
+void
+transcodeTagsAndOrders(InputArchive& in,
+                       OutputArchive& out,
+                       ShouldSerializePred const& should_serialize)
+{
+  out(cereal::make_nvp("tags", loadTags(in, should_serialize)));
+
+  auto orders = std::vector<detail::StorageOrder>{};
+  in(orders);
+  std::erase_if(orders, [&should_serialize](auto const& order) {
+    return !should_serialize(order.name.c_str());
+  });
+  out(cereal::make_nvp("storage_order", orders));
+}
+
+/**
+ * Transcodes between binary archives of the same format. Unless components
+ * have to be migrated, the component records are copied undecoded.
+ * */
+template<typename In, typename Out>
+void
+transcodeRecords(In& in, Out& out, ShouldSerializePred const& should_serialize)
+{
+  auto in_archive = InputArchive{ in };
+  auto out_archive = OutputArchive{ out };
+
+  auto context = detail::LoadContext{};
+  auto versions = upgradeVersions(in_archive, context);
+  out_archive(cereal::make_nvp("versions", versions));
+
+  auto sz = std::uint64_t{ 0 };
+  in(sz);
+  out(sz);
+
+  if (context.outdated.empty()) {
+    copyRecords(in, out, sz, should_serialize);
+  } else {
+    transcodeEntities(
+      in_archive,
+      sz,
+      should_serialize,
+      context,
+      [&out_archive](DecodedEntity& decoded) {
+        writeDecoded(out_archive, decoded);
+      });
+  }
+
+  transcodeTagsAndOrders(in_archive, out_archive, should_serialize);
+}
+
+} // namespace
+
+SnapshotFormat
+parseSnapshotFormat(std::string_view name)
+{
+  if (name == "json") {
+    return SnapshotFormat::json;
+  } else if (name == "binary") {
+    return SnapshotFormat::binary;
+  } else if (name == "portable") {
+    return SnapshotFormat::portable;
+  } else if (name == "mapped") {
+    return SnapshotFormat::mapped;
+  }
+  throw std::invalid_argument("Unknown snapshot format " + std::string{ name });
+}
+
+#pragma region transcoder
+
+void
+Transcoder::transcode(InputArchive in,
+                      OutputArchive out,
+                      ShouldSerializePred should_serialize)
+{
+  auto context = detail::LoadContext{};
+  out(cereal::make_nvp("versions", upgradeVersions(in, context)));
+
+  auto sz = std::uint64_t{ 0 };
+  in(sz);
+  out(cereal::make_nvp("e_count", sz));
+
+  transcodeEntities(
+    in, sz, should_serialize, context, [&out](DecodedEntity& decoded) {
+      writeDecoded(out, decoded);
+    });
+
+  transcodeTagsAndOrders(in, out, should_serialize);
+}
+
+void
+Transcoder::transcode(InputArchive in,
+                      MappedSnapshotWriter& writer,
+                      ShouldSerializePred should_serialize)
+{
+  auto context = detail::LoadContext{};
+  upgradeVersions(in, context);
+
+  auto sz = std::uint64_t{ 0 };
+  in(sz);
+
+  transcodeEntities(
+    in, sz, should_serialize, context, [&writer](DecodedEntity& decoded) {
+      writer.add(decoded.e);
+      for (auto& comp : decoded.components) {
+        writer.write(decoded.e, Handle{ *comp });
+      }
+    });
+
+  // mapped snapshots keep tags per entity
+  for (auto const& tag : loadTags(in, should_serialize)) {
+    auto refl = Reflection{ tag.name };
+    if (!refl) {
+      continue;
+    }
+
+    auto instance = refl.type().construct();
+    tag.each([&writer, &instance](entt::entity e) {
+      writer.write(e, Handle{ instance });
+    });
+  }
+
+  writer.finish();
+}
+
+void
+Transcoder::transcode(SnapshotView& view,
+                      OutputArchive out,
+                      ShouldSerializePred should_serialize)
+{
+  // mapped snapshots contain reflected versions only
+  out(cereal::make_nvp("versions", detail::ComponentVersions{}));
+  out(cereal::make_nvp("e_count", static_cast<std::uint64_t>(view.size())));
+
+  auto tag_ids = std::map<std::string, std::vector<std::uint64_t>>{};
+  for (auto i = 0UL; i < view.size(); ++i) {
+    auto e = view.entity(i);
+
+    auto e_serial =
+      detail::SerializeHandleEntity{ .e = e,
+                                     .components = std::vector<Handle>{} };
+    for (auto const& refl : viewComponents(view, e, should_serialize)) {
+      if (ComponentReflection{ refl }.isTag()) {
+        auto name = refl.name();
+        tag_ids[std::string{ name.data() }].push_back(entt::to_integral(e));
+      } else {
+        e_serial.components.push_back(Handle{ view.get(e, refl) });
+      }
+    }
+
+    auto label = std::to_string(entt::to_integral(e));
+    out(cereal::make_nvp(label, e_serial));
+
+    // only the current entity's components need to be kept decoded
+    view.clearCache();
+  }
+
+  auto tags = std::vector<detail::TagSet>{};
+  for (auto& [name, ids] : tag_ids) {
+    auto& tag = tags.emplace_back(
+      detail::TagSet{ .name = name, .runs = {}, .versions = {} });
+    tag.assign(ids);
+  }
+  out(cereal::make_nvp("tags", tags));
+
+  // mapped snapshots don't keep the storages' order
+  out(cereal::make_nvp("storage_order", std::vector<detail::StorageOrder>{}));
+}
+
+void
+Transcoder::transcode(SnapshotView& view,
+                      MappedSnapshotWriter& writer,
+                      ShouldSerializePred should_serialize)
+{
+  for (auto i = 0UL; i < view.size(); ++i) {
+    auto e = view.entity(i);
+
+    writer.add(e);
+    for (auto const& refl : viewComponents(view, e, should_serialize)) {
+      writer.write(e, Handle{ view.get(e, refl) });
+    }
+    view.clearCache();
+  }
+
+  writer.finish();
+}
+
+void
+Transcoder::transcode(std::filesystem::path const& in,
+                      SnapshotFormat from,
+                      std::filesystem::path const& out,
+                      SnapshotFormat to,
+                      ShouldSerializePred should_serialize)
+{
+  if (from == SnapshotFormat::mapped && to == SnapshotFormat::mapped) {
+    auto view = SnapshotView{ in };
+    auto stream = std::ofstream{ out, std::ios::binary | std::ios::trunc };
+    if (!stream) {
+      throw std::runtime_error("Failed to open " + out.string());
+    }
+    auto writer = MappedSnapshotWriter{ stream };
+    transcode(view, writer, should_serialize);
+
+  } else if (from == SnapshotFormat::mapped) {
+    auto view = SnapshotView{ in };
+    withOutput(out, to, [&](OutputArchive archive) {
+      transcode(view, archive, should_serialize);
+    });
+
+  } else if (to == SnapshotFormat::mapped) {
+    auto stream = std::ofstream{ out, std::ios::binary | std::ios::trunc };
+    if (!stream) {
+      throw std::runtime_error("Failed to open " + out.string());
+    }
+    auto writer = MappedSnapshotWriter{ stream };
+    withInput(in, from, [&](InputArchive archive) {
+      transcode(archive, writer, should_serialize);
+    });
+
+  } else if (from == to && from != SnapshotFormat::json) {
+    withRecordArchives(in, out, from, [&](auto& in_archive, auto& out_archive) {
+      transcodeRecords(in_archive, out_archive, should_serialize);
+    });
+
+  } else {
+    withInput(in, from, [&](InputArchive in_archive) {
+      withOutput(out, to, [&](OutputArchive out_archive) {
+        transcode(in_archive, out_archive, should_serialize);
+      });
+    });
+  }
+}
+
+int
+Transcoder::main(int argc, char** argv)
+{
+  auto from = std::string{};
+  auto to = std::string{};
+  auto jobs = std::max(1U, std::thread::hardware_concurrency());
+  auto should_serialize = ShouldSerialize::tautology();
+  auto files = std::vector<std::filesystem::path>{};
+
+  try {
+    for (auto i = 1; i < argc; ++i) {
+      auto arg = std::string_view{ argv[i] };
+      auto has_value = i + 1 < argc;
+
+      if (arg == "--from" && has_value) {
+        from = argv[++i];
+      } else if (arg == "--to" && has_value) {
+        to = argv[++i];
+      } else if (arg == "--jobs" && has_value) {
+        jobs = std::max(1, std::stoi(argv[++i]));
+      } else if (arg == "--only" && has_value) {
+        should_serialize = onlyNames(argv[++i]);
+      } else if (arg.starts_with("--")) {
+        std::cerr << USAGE;
+        return 1;
+      } else {
+        files.emplace_back(arg);
+      }
+    }
+
+    if (from.empty() || to.empty() || files.empty() || files.size() % 2 != 0) {
+      std::cerr << USAGE;
+      return 1;
+    }
+
+    if (!hasReflectedComponents()) {
+      throw std::runtime_error(
+        "no components are reflected, registerSnapshotComponents() has to "
+        "reflect the components of the snapshots");
+    }
+
+    auto from_format = parseSnapshotFormat(from);
+    auto to_format = parseSnapshotFormat(to);
+
+    auto next = std::atomic<std::size_t>{ 0 };
+    auto worker = [&] {
+      for (auto i = next++; 2 * i < files.size(); i = next++) {
+        transcode(files[2 * i],
+                  from_format,
+                  files[2 * i + 1],
+                  to_format,
+                  should_serialize);
+      }
+    };
+
+    auto workers = std::vector<std::future<void>>{};
+    auto worker_count = std::min<std::size_t>(jobs, files.size() / 2);
+    for (auto i = 0UL; i < worker_count; ++i) {
+      workers.push_back(std::async(std::launch::async, worker));
+    }
+    for (auto& w : workers) {
+      w.get();
+    }
+  } catch (std::exception const& e) {
+    std::cerr << "entt_snapshot_transcode: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
+
+#pragma endregion // transcoder
+
+} // namespace snapshot
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include <entt_snapshot/Reflection.hpp>
+
+/**
+ * Components used by the tests and the test transcoder.
+ * */
+
+inline constexpr std::string_view TEST_COMPONENT_NAME = "test_comp";
+inline constexpr std::string_view OTHER_COMPONENT_NAME = "other_comp";
+inline constexpr std::string_view VERSIONED_COMPONENT_NAME = "versioned_comp";
+inline constexpr std::string_view TAG_COMPONENT_NAME = "tag_comp";
+inline constexpr std::string_view NODE_COMPONENT_NAME = "node_comp";
+inline constexpr std::string_view GAPPED_COMPONENT_NAME = "gapped_comp";
+
+struct TestComponent
+{
+  size_t some_value;
+
+private:
+  friend class cereal::access;
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(some_value));
+  }
+};
+
+struct OtherComponent
+{
+  size_t some_other_value;
+
+private:
+  friend class cereal::access;
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(some_other_value));
+  }
+};
+
+struct TagComponent
+{
+private:
+  friend class cereal::access;
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {}
+};
+
+struct NodeComponent
+{
+  entt::entity parent;
+  std::vector<entt::entity> children;
+
+private:
+  friend class cereal::access;
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(parent), CEREAL_NVP(children));
+  }
+};
+
+struct VersionedComponent
+{
+  size_t value;
+
+private:
+  friend class cereal::access;
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(value));
+  }
+};
+
+/**
+ * Version 2 without a migration from version 0, but with one beyond.
+ * */
+struct GappedComponent
+{
+  size_t value;
+
+private:
+  friend class cereal::access;
+  template<typename Archive>
+  void serialize(Archive& archive)
+  {
+    archive(CEREAL_NVP(value));
+  }
+};
+
+inline void
+registerTestComponents()
+{
+  using namespace snapshot;
+
+  reflectComponent<TestComponent, TEST_COMPONENT_NAME>();
+  reflectComponent<OtherComponent, OTHER_COMPONENT_NAME>();
+  reflectComponent<TagComponent, TAG_COMPONENT_NAME>();
+  reflectComponent<NodeComponent, NODE_COMPONENT_NAME>();
+  registerEntityRef<NodeComponent, &NodeComponent::parent>();
+  registerEntityRef<NodeComponent, &NodeComponent::children>();
+  reflectComponent<VersionedComponent, VERSIONED_COMPONENT_NAME, 2>();
+  registerMigration<VersionedComponent>(
+    0, [](std::span<VersionedComponent* const> comps) {
+      for (auto comp : comps) {
+        comp->value *= 2;
+      }
+    });
+  registerMigration<VersionedComponent>(
+    1, [](std::span<VersionedComponent* const> comps) {
+      for (auto comp : comps) {
+        comp->value += 1;
+      }
+    });
+
+  reflectComponent<GappedComponent, GAPPED_COMPONENT_NAME, 2>();
+  registerMigration<GappedComponent>(
+    1, [](std::span<GappedComponent* const> comps) {
+      for (auto comp : comps) {
+        comp->value += 1;
+      }
+    });
+  registerMigration<GappedComponent>(
+    2, [](std::span<GappedComponent* const> comps) {
+      for (auto comp : comps) {
+        comp->value += 10;
+      }
+    });
+}
@@ -1,14 +1,29 @@
 
+#include <array>
 #include <entt/entt.hpp>
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <memory>
 #include <string_view>
+#include <utility>
+#include <vector>
 
+#include <entt_snapshot/BufferArchive.hpp>
+#include <entt_snapshot/Checksum.hpp>
+#include <entt_snapshot/Endian.hpp>
+#include <entt_snapshot/Journal.hpp>
+#include <entt_snapshot/MappedSnapshot.hpp>
+#include <entt_snapshot/Profiler.hpp>
 #include <entt_snapshot/Reflection.hpp>
+#include <entt_snapshot/RollbackBuffer.hpp>
+#include <entt_snapshot/Schema.hpp>
+#include <entt_snapshot/Snapshot.hpp>
+#include <entt_snapshot/Transcoder.hpp>
 
-using namespace snapshot;
+#include "components.hpp"
 
-constexpr std::string_view TEST_COMPONENT_NAME = "test_comp";
-constexpr std::string_view OTHER_COMPONENT_NAME = "other_comp";
+using namespace snapshot;
 
 entt::handle
 createHandle(entt::registry& reg)
@@ -16,32 +31,6 @@ createHandle(entt::registry& reg)
   return entt::handle{ reg, reg.create() };
 }
 
-struct TestComponent
-{
-  size_t some_value;
-
-private:
-  friend class cereal::access;
-  template<typename Archive>
-  void serialize(Archive& archive)
-  {
-    archive(CEREAL_NVP(some_value));
-  }
-};
-
-struct OtherComponent
-{
-  size_t some_other_value;
-
-private:
-  friend class cereal::access;
-  template<typename Archive>
-  void serialize(Archive& archive)
-  {
-    archive(CEREAL_NVP(some_other_value));
-  }
-};
-
 TEST(ReflectionTest, haveName)
 {
   auto accu_name = std::string{ TEST_COMPONENT_NAME.data() };
@@ -179,13 +168,1091 @@ TEST(HandleTest, throwOnLoad)
   EXPECT_THROW(iarchive(mh), std::runtime_error);
 }
 
+TEST(ChecksumTest, equalForEqualState)
+{
+  auto first = entt::registry{};
+  auto second = entt::registry{};
+
+  // emplace in different orders, storages' order must not matter
+  auto a = first.create();
+  auto b = first.create();
+  first.emplace<TestComponent>(a, TestComponent{ .some_value = 1UL });
+  first.emplace<TestComponent>(b, TestComponent{ .some_value = 2UL });
+
+  second.create();
+  second.create();
+  second.emplace<TestComponent>(b, TestComponent{ .some_value = 2UL });
+  second.emplace<TestComponent>(a, TestComponent{ .some_value = 1UL });
+
+  auto pred = ShouldSerialize::tautology();
+  EXPECT_EQ(Checksum::compute(first, pred), Checksum::compute(second, pred));
+}
+
+TEST(ChecksumTest, reportChangedTypes)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+  h.emplace<OtherComponent>(OtherComponent{ .some_other_value = 1UL });
+
+  auto pred = ShouldSerialize::tautology();
+  auto before = Checksum::compute(reg, pred);
+  h.get<OtherComponent>().some_other_value = 2UL;
+  auto after = Checksum::compute(reg, pred);
+
+  EXPECT_FALSE(before == after);
+  auto changed = after.changed(before);
+  ASSERT_EQ(changed.size(), 1UL);
+  EXPECT_EQ(changed.front(), OTHER_COMPONENT_NAME);
+}
+
+TEST(ChecksumTest, canonicalComponentHash)
+{
+  // the little-endian encoding of the single member, on every host
+  auto value = toLittleEndian(std::uint64_t{ 5 });
+  EXPECT_EQ(ComponentHash<TestComponent>{}(TestComponent{ .some_value = 5UL }),
+            hashBytes(&value, sizeof(value)));
+}
+
+TEST(SnapshotViewTest, lazyGet)
+{
+  auto path = std::filesystem::temp_directory_path() / "snapshot_view.bin";
+
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 7UL });
+  auto other = createHandle(reg);
+  other.emplace<OtherComponent>(OtherComponent{ .some_other_value = 3UL });
+  {
+    auto stream = std::ofstream{ path, std::ios::binary };
+    MappedSnapshot::save(stream, reg, ShouldSerialize::tautology());
+  }
+
+  auto view = SnapshotView{ path };
+  auto test_refl = Reflection{ TEST_COMPONENT_NAME };
+  EXPECT_EQ(view.size(), 2UL);
+  EXPECT_TRUE(view.contains(h.entity(), test_refl));
+  EXPECT_FALSE(view.contains(other.entity(), test_refl));
+  EXPECT_EQ(view.get<TestComponent>(h.entity()).some_value, 7UL);
+  EXPECT_EQ(view.get<OtherComponent>(other.entity()).some_other_value, 3UL);
+  EXPECT_THROW(view.get(other.entity(), test_refl), std::runtime_error);
+
+  std::filesystem::remove(path);
+}
+
+TEST(SnapshotViewTest, throwOnCorruptTables)
+{
+  auto path = std::filesystem::temp_directory_path() / "snapshot_corrupt.bin";
+
+  auto reg = entt::registry{};
+  createHandle(reg).emplace<TestComponent>();
+  {
+    auto stream = std::ofstream{ path, std::ios::binary };
+    MappedSnapshot::save(stream, reg, ShouldSerialize::tautology());
+  }
+
+  // a component count whose table size overflows
+  auto count = toLittleEndian(std::uint64_t{ 1 } << 62);
+  {
+    auto stream =
+      std::fstream{ path, std::ios::binary | std::ios::in | std::ios::out };
+    stream.seekp(-static_cast<std::streamoff>(sizeof(count)), std::ios::end);
+    stream.write(reinterpret_cast<char const*>(&count), sizeof(count));
+  }
+  EXPECT_THROW(SnapshotView{ path }, std::runtime_error);
+
+  // a truncated file
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+  EXPECT_THROW(SnapshotView{ path }, std::runtime_error);
+
+  std::filesystem::remove(path);
+}
+
+TEST(EndianTest, byteswapColumn)
+{
+  auto column = std::vector<std::uint32_t>{ 0x01020304U, 0xAABBCCDDU };
+  byteswapColumn(column.data(), column.size());
+
+  EXPECT_EQ(column[0], 0x04030201U);
+  EXPECT_EQ(column[1], 0xDDCCBBAAU);
+}
+
+TEST(SnapshotTest, portableRoundtrip)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 5UL });
+  h.emplace<OtherComponent>(OtherComponent{ .some_other_value = 6UL });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::PortableBinaryOutputArchive{
+      stream, cereal::PortableBinaryOutputArchive::Options::LittleEndian()
+    };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::PortableBinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+
+  EXPECT_EQ(loaded.get<TestComponent>(h.entity()).some_value, 5UL);
+  EXPECT_EQ(loaded.get<OtherComponent>(h.entity()).some_other_value, 6UL);
+}
+
+TEST(SnapshotTest, selectiveLoad)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  first.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+  first.emplace<OtherComponent>(OtherComponent{ .some_other_value = 2UL });
+  auto second = createHandle(reg);
+  second.emplace<TestComponent>(TestComponent{ .some_value = 3UL });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(
+      archive,
+      loaded,
+      [](char const* name) { return name == TEST_COMPONENT_NAME; },
+      ShouldLoadEntity::range(first.entity(), second.entity()));
+  }
+
+  EXPECT_TRUE(loaded.valid(first.entity()));
+  EXPECT_FALSE(loaded.valid(second.entity()));
+  EXPECT_EQ(loaded.get<TestComponent>(first.entity()).some_value, 1UL);
+  EXPECT_FALSE(loaded.all_of<OtherComponent>(first.entity()));
+}
+
+TEST(SnapshotTest, selectiveLoadRecycled)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  reg.destroy(first.entity());
+  auto recycled = createHandle(reg);
+  recycled.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+  ASSERT_NE(entt::to_version(recycled.entity()), 0U);
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(
+      archive,
+      loaded,
+      ShouldSerialize::tautology(),
+      ShouldLoadEntity::range(entt::entity{ 0 }, second.entity()));
+  }
+
+  EXPECT_TRUE(loaded.valid(recycled.entity()));
+  EXPECT_FALSE(loaded.valid(second.entity()));
+  EXPECT_EQ(loaded.get<TestComponent>(recycled.entity()).some_value, 1UL);
+}
+
+TEST(TranscoderTest, jsonToBinary)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 8UL });
+
+  auto json = std::stringstream{};
+  {
+    auto archive = cereal::JSONOutputArchive{ json };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto binary = std::stringstream{};
+  {
+    auto in = cereal::JSONInputArchive{ json };
+    auto out = cereal::BinaryOutputArchive{ binary };
+    Transcoder::transcode(in, out, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ binary };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+  EXPECT_EQ(loaded.get<TestComponent>(h.entity()).some_value, 8UL);
+}
+
+TEST(TranscoderTest, mappedToMappedFilters)
+{
+  auto in = std::filesystem::temp_directory_path() / "transcode_in.bin";
+  auto out = std::filesystem::temp_directory_path() / "transcode_out.bin";
+
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 8UL });
+  h.emplace<OtherComponent>(OtherComponent{ .some_other_value = 9UL });
+  {
+    auto stream = std::ofstream{ in, std::ios::binary };
+    MappedSnapshot::save(stream, reg, ShouldSerialize::tautology());
+  }
+
+  Transcoder::transcode(
+    in, SnapshotFormat::mapped, out, SnapshotFormat::mapped, [](char const* n) {
+      return n == TEST_COMPONENT_NAME;
+    });
+
+  auto view = SnapshotView{ out };
+  EXPECT_EQ(view.get<TestComponent>(h.entity()).some_value, 8UL);
+  EXPECT_FALSE(view.contains(h.entity(), Reflection{ OTHER_COMPONENT_NAME }));
+
+  std::filesystem::remove(in);
+  std::filesystem::remove(out);
+}
+
+TEST(TranscoderTest, binaryToBinaryCopiesRecords)
+{
+  auto in = std::filesystem::temp_directory_path() / "transcode_in.bin";
+  auto out = std::filesystem::temp_directory_path() / "transcode_out.bin";
+
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 8UL });
+  h.emplace<OtherComponent>(OtherComponent{ .some_other_value = 9UL });
+  h.emplace<TagComponent>();
+  {
+    auto stream = std::ofstream{ in, std::ios::binary };
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  Transcoder::transcode(
+    in, SnapshotFormat::binary, out, SnapshotFormat::binary, [](char const* n) {
+      return n != OTHER_COMPONENT_NAME;
+    });
+
+  auto loaded = entt::registry{};
+  {
+    auto stream = std::ifstream{ out, std::ios::binary };
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+  EXPECT_EQ(loaded.get<TestComponent>(h.entity()).some_value, 8UL);
+  EXPECT_TRUE(loaded.all_of<TagComponent>(h.entity()));
+  EXPECT_FALSE(loaded.all_of<OtherComponent>(h.entity()));
+
+  std::filesystem::remove(in);
+  std::filesystem::remove(out);
+}
+
+TEST(SnapshotTest, restoreStorageOrder)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  second.emplace<TestComponent>(TestComponent{ .some_value = 2UL });
+  first.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+
+  auto const& storage = loaded.storage<TestComponent>();
+  ASSERT_EQ(storage.size(), 2UL);
+  EXPECT_EQ(storage.data()[0], second.entity());
+  EXPECT_EQ(storage.data()[1], first.entity());
+}
+
+TEST(SnapshotTest, skipStorageOrderOfSavedOrder)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  first.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+  second.emplace<TestComponent>(TestComponent{ .some_value = 2UL });
+  second.emplace<OtherComponent>(OtherComponent{ .some_other_value = 3UL });
+  first.emplace<OtherComponent>(OtherComponent{ .some_other_value = 4UL });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::JSONOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  // only the storage deviating from the entities' order is kept
+  auto json = stream.str();
+  auto orders = json.substr(json.find("storage_order"));
+  EXPECT_EQ(orders.find(TEST_COMPONENT_NAME), std::string::npos);
+  EXPECT_NE(orders.find(OTHER_COMPONENT_NAME), std::string::npos);
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::JSONInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+  EXPECT_EQ(loaded.storage<TestComponent>().data()[0], first.entity());
+  EXPECT_EQ(loaded.storage<OtherComponent>().data()[0], second.entity());
+}
+
+TEST(SnapshotTest, loadHandleIntoRegistry)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 2UL });
+  h.emplace<TagComponent>();
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(
+      archive, entt::const_handle{ h }, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+  EXPECT_EQ(loaded.get<TestComponent>(h.entity()).some_value, 2UL);
+  EXPECT_TRUE(loaded.all_of<TagComponent>(h.entity()));
+}
+
+TEST(SnapshotTest, coSort)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  first.emplace<TestComponent>();
+  second.emplace<TestComponent>();
+  second.emplace<OtherComponent>();
+  first.emplace<OtherComponent>();
+
+  SnapshotLoader::coSort(reg,
+                         { std::string{ TEST_COMPONENT_NAME },
+                           std::string{ OTHER_COMPONENT_NAME } });
+
+  auto const& lead = reg.storage<TestComponent>();
+  auto const& other = reg.storage<OtherComponent>();
+  EXPECT_EQ(lead.data()[0], other.data()[0]);
+  EXPECT_EQ(lead.data()[1], other.data()[1]);
+}
+
+TEST(MigrationTest, migrateStorage)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<VersionedComponent>(VersionedComponent{ .value = 2UL });
+
+  auto refl = ComponentReflection{ Reflection{ VERSIONED_COMPONENT_NAME } };
+  EXPECT_EQ(refl.version(), 2U);
+
+  // both registered migrations (0 -> 1 -> 2) are applied
+  refl.migrate(reg, 0, { h.entity() });
+  EXPECT_EQ(h.get<VersionedComponent>().value, 5UL);
+}
+
+TEST(MigrationTest, throwOnMissingStep)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<GappedComponent>(GappedComponent{ .value = 1UL });
+
+  auto refl = ComponentReflection{ Reflection{ GAPPED_COMPONENT_NAME } };
+  EXPECT_THROW(refl.migrate(reg, 0, { h.entity() }), std::runtime_error);
+  EXPECT_EQ(h.get<GappedComponent>().value, 1UL);
+
+  // only 1 -> 2 is applied, not the step beyond the reflected version
+  refl.migrate(reg, 1, { h.entity() });
+  EXPECT_EQ(h.get<GappedComponent>().value, 2UL);
+}
+
+struct LoadListener
+{
+  void onConstruct(entt::registry&, entt::entity) { ++constructed; }
+  void onLoaded(entt::registry&, std::span<entt::entity const> entities)
+  {
+    loaded.insert(loaded.end(), entities.begin(), entities.end());
+  }
+
+  std::size_t constructed = 0;
+  std::vector<entt::entity> loaded;
+};
+
+TEST(SnapshotTest, deferSignals)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  first.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+  second.emplace<TestComponent>(TestComponent{ .some_value = 2UL });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto listener = LoadListener{};
+  auto signals = LoadSignals{};
+  signals.onLoaded<TestComponent>().connect<&LoadListener::onLoaded>(listener);
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive,
+                         loaded,
+                         ShouldSerialize::tautology(),
+                         ShouldLoadEntity::tautology(),
+                         signals);
+  }
+
+  ASSERT_EQ(listener.loaded.size(), 2UL);
+  EXPECT_EQ(loaded.get<TestComponent>(second.entity()).some_value, 2UL);
+}
+
+TEST(SnapshotTest, deferSignalsRejectListeners)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>();
+  h.emplace<OtherComponent>();
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  // the group listens to both storages and would miss silent instances
+  auto loaded = entt::registry{};
+  auto group = loaded.group<TestComponent>(entt::get<OtherComponent>);
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    auto signals = LoadSignals{};
+    EXPECT_THROW(SnapshotLoader::load(archive,
+                                      loaded,
+                                      ShouldSerialize::tautology(),
+                                      ShouldLoadEntity::tautology(),
+                                      signals),
+                 std::runtime_error);
+  }
+  EXPECT_TRUE(group.empty());
+  EXPECT_EQ(loaded.size(), 0UL);
+}
+
+struct UnreflectedComponent
+{
+  int value;
+};
+
+TEST(SnapshotTest, throwOnUnreflectedSignal)
+{
+  auto signals = LoadSignals{};
+  EXPECT_THROW(signals.onLoaded<UnreflectedComponent>(), std::runtime_error);
+}
+
+TEST(SnapshotTest, tagsRoundtrip)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  auto third = createHandle(reg);
+  first.emplace<TagComponent>();
+  second.emplace<TagComponent>();
+  second.emplace<TestComponent>(TestComponent{ .some_value = 4UL });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+
+  EXPECT_TRUE(loaded.all_of<TagComponent>(first.entity()));
+  EXPECT_TRUE(loaded.all_of<TagComponent>(second.entity()));
+  EXPECT_FALSE(loaded.all_of<TagComponent>(third.entity()));
+  EXPECT_EQ(loaded.get<TestComponent>(second.entity()).some_value, 4UL);
+}
+
+TEST(TagSetTest, runs)
+{
+  auto tag = detail::TagSet{ .name = "tag", .runs = {}, .versions = {} };
+  tag.assign({ 7, 3, 4, 5, 9 });
+  EXPECT_EQ(tag.runs, (std::vector<std::uint64_t>{ 3, 3, 7, 1, 9, 1 }));
+  EXPECT_TRUE(tag.versions.empty());
+
+  auto ids = std::vector<entt::entity>{};
+  tag.each([&ids](entt::entity e) { ids.push_back(e); });
+  EXPECT_EQ(ids.size(), 5UL);
+}
+
+TEST(TagSetTest, recycledRuns)
+{
+  using traits = entt::entt_traits<entt::entity>;
+  auto recycled = traits::construct(4, 2);
+
+  auto tag = detail::TagSet{ .name = "tag", .runs = {}, .versions = {} };
+  tag.assign({ 3, entt::to_integral(recycled), 5 });
+  EXPECT_EQ(tag.runs, (std::vector<std::uint64_t>{ 3, 3 }));
+  EXPECT_EQ(tag.versions, (std::vector<std::uint32_t>{ 1, 2 }));
+
+  auto ids = std::vector<entt::entity>{};
+  tag.each([&ids](entt::entity e) { ids.push_back(e); });
+  ASSERT_EQ(ids.size(), 3UL);
+  EXPECT_EQ(ids[1], recycled);
+  EXPECT_EQ(entt::to_version(ids[2]), 0U);
+}
+
+TEST(SnapshotTest, saveClosure)
+{
+  auto reg = entt::registry{};
+  auto root = createHandle(reg);
+  auto child = createHandle(reg);
+  auto unrelated = createHandle(reg);
+  root.emplace<NodeComponent>(
+    NodeComponent{ .parent = entt::null, .children = { child.entity() } });
+  child.emplace<NodeComponent>(
+    NodeComponent{ .parent = root.entity(), .children = {} });
+  unrelated.emplace<TestComponent>();
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(
+      archive, reg, { root.entity() }, ShouldSerialize::tautology());
+  }
+
+  // occupied identifiers force the loaded entities to be remapped
+  auto loaded = entt::registry{};
+  for (auto i = 0; i < 3; ++i) {
+    loaded.create();
+  }
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+
+  EXPECT_EQ(loaded.size(), 5UL);
+  auto view = loaded.view<NodeComponent>();
+  ASSERT_EQ(view.size(), 2UL);
+  for (auto e : view) {
+    auto const& node = view.get<NodeComponent>(e);
+    if (node.parent == entt::null) {
+      ASSERT_EQ(node.children.size(), 1UL);
+      EXPECT_EQ(loaded.get<NodeComponent>(node.children[0]).parent, e);
+    }
+  }
+  EXPECT_TRUE(loaded.storage<TestComponent>().empty());
+}
+
+TEST(EntityRefTest, registerOnce)
+{
+  // registered in main already, the second registration has no effect
+  registerEntityRef<NodeComponent, &NodeComponent::parent>();
+
+  auto reg = entt::registry{};
+  auto parent = reg.create();
+  auto node = NodeComponent{ .parent = parent, .children = {} };
+
+  auto refl = ComponentReflection{ Reflection{ NODE_COMPONENT_NAME } };
+  auto refs = std::vector<entt::entity>{};
+  refl.collectEntityRefs(entt::meta_handle{ node }, refs);
+  EXPECT_EQ(refs, (std::vector<entt::entity>{ parent }));
+
+  auto mapped = reg.create();
+  auto mapping = detail::EntityMapping{ { parent, mapped } };
+  refl.remapEntityRefs({ &node }, mapping);
+  EXPECT_EQ(node.parent, mapped);
+}
+
+struct ParentListener
+{
+  void onConstruct(entt::registry& reg, entt::entity e)
+  {
+    parents.emplace_back(e, reg.get<NodeComponent>(e).parent);
+  }
+
+  std::vector<std::pair<entt::entity, entt::entity>> parents;
+};
+
+TEST(SnapshotTest, constructRemapped)
+{
+  auto reg = entt::registry{};
+  auto root = createHandle(reg);
+  auto child = createHandle(reg);
+  root.emplace<NodeComponent>(
+    NodeComponent{ .parent = entt::null, .children = { child.entity() } });
+  child.emplace<NodeComponent>(
+    NodeComponent{ .parent = root.entity(), .children = {} });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto listener = ParentListener{};
+  auto loaded = entt::registry{};
+  loaded.create();
+  loaded.on_construct<NodeComponent>().connect<&ParentListener::onConstruct>(
+    listener);
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+
+  // listeners observe the remapped references, not the saved ones
+  ASSERT_EQ(listener.parents.size(), 2UL);
+  for (auto [e, parent] : listener.parents) {
+    EXPECT_EQ(parent, loaded.get<NodeComponent>(e).parent);
+  }
+}
+
+TEST(SchemaTest, roundtrip)
+{
+  auto schema = Schema{};
+  schema.reflectComponent<TestComponent, TEST_COMPONENT_NAME>()
+    .reflectComponent<NodeComponent, NODE_COMPONENT_NAME>()
+    .registerEntityRef<NodeComponent, &NodeComponent::parent>();
+  EXPECT_EQ(schema.index<NodeComponent>(), 1UL);
+  EXPECT_EQ(schema.index(OTHER_COMPONENT_NAME), Schema::npos);
+
+  auto reg = entt::registry{};
+  auto parent = createHandle(reg);
+  auto child = createHandle(reg);
+  parent.emplace<TestComponent>(TestComponent{ .some_value = 3UL });
+  parent.emplace<OtherComponent>(OtherComponent{ .some_other_value = 4UL });
+  child.emplace<NodeComponent>(
+    NodeComponent{ .parent = parent.entity(), .children = {} });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    schema.save(archive, reg);
+  }
+
+  auto loaded = entt::registry{};
+  loaded.create();
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    schema.load(archive, loaded);
+  }
+
+  auto view = loaded.view<NodeComponent>();
+  ASSERT_EQ(view.size(), 1UL);
+  auto loaded_parent = view.get<NodeComponent>(view.front()).parent;
+  EXPECT_EQ(loaded.get<TestComponent>(loaded_parent).some_value, 3UL);
+  EXPECT_TRUE(loaded.storage<OtherComponent>().empty());
+}
+
+TEST(SchemaTest, tagsAndStorageOrder)
+{
+  auto schema = Schema{};
+  schema.reflectComponent<TestComponent, TEST_COMPONENT_NAME>()
+    .reflectComponent<TagComponent, TAG_COMPONENT_NAME>();
+
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  second.emplace<TestComponent>(TestComponent{ .some_value = 2UL });
+  first.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+  first.emplace<TagComponent>();
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    schema.save(archive, reg);
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    schema.load(archive, loaded);
+  }
+  EXPECT_TRUE(loaded.all_of<TagComponent>(first.entity()));
+  EXPECT_FALSE(loaded.all_of<TagComponent>(second.entity()));
+  EXPECT_EQ(loaded.storage<TestComponent>().data()[0], second.entity());
+}
+
+TEST(SchemaTest, localMigrations)
+{
+  auto saving = Schema{};
+  saving.reflectComponent<VersionedComponent, VERSIONED_COMPONENT_NAME>();
+
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<VersionedComponent>(VersionedComponent{ .value = 1UL });
+
+  auto stream = std::stringstream{};
+  {
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    saving.save(archive, reg);
+  }
+
+  auto loading = Schema{};
+  loading.reflectComponent<VersionedComponent, VERSIONED_COMPONENT_NAME, 1>()
+    .registerMigration<VersionedComponent>(
+      0, [](std::span<VersionedComponent* const> comps) {
+        for (auto comp : comps) {
+          comp->value += 10;
+        }
+      });
+  EXPECT_THROW(loading.registerMigration<TestComponent>(0, {}),
+               std::runtime_error);
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    loading.load(archive, loaded);
+  }
+
+  // only the schema's migration applies, not the global ones
+  EXPECT_EQ(loaded.get<VersionedComponent>(h.entity()).value, 11UL);
+}
+
+TEST(JournalTest, recover)
+{
+  auto directory = std::filesystem::temp_directory_path() / "journal_test";
+  std::filesystem::remove_all(directory);
+
+  auto reg = entt::registry{};
+  auto kept = createHandle(reg);
+  auto removed = createHandle(reg);
+  auto destroyed = createHandle(reg);
+  kept.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+  removed.emplace<TestComponent>(TestComponent{ .some_value = 2UL });
+  removed.emplace<TagComponent>();
+  destroyed.emplace<TestComponent>(TestComponent{ .some_value = 5UL });
+  auto recycled = entt::handle{};
+  {
+    auto journal =
+      Journal{ reg, directory, ShouldSerialize::tautology(), JournalOptions{} };
+    kept.replace<TestComponent>(TestComponent{ .some_value = 3UL });
+    kept.emplace<OtherComponent>(OtherComponent{ .some_other_value = 4UL });
+    removed.remove<TestComponent>();
+    reg.destroy(destroyed.entity());
+    recycled = createHandle(reg);
+    recycled.emplace<TestComponent>(TestComponent{ .some_value = 6UL });
+    journal.flush();
+  }
+  {
+    // a torn record at the end is ignored
+    auto stream = std::ofstream{ directory / Journal::JOURNAL_FILE,
+                                 std::ios::binary | std::ios::app };
+    stream << "torn";
+  }
+
+  auto recovered = entt::registry{};
+  auto count =
+    Journal::recover(recovered, directory, ShouldSerialize::tautology());
+  EXPECT_EQ(count, 5UL);
+  EXPECT_EQ(recovered.get<TestComponent>(kept.entity()).some_value, 3UL);
+  EXPECT_EQ(recovered.get<OtherComponent>(kept.entity()).some_other_value,
+            4UL);
+  EXPECT_FALSE(recovered.all_of<TestComponent>(removed.entity()));
+  EXPECT_TRUE(recovered.all_of<TagComponent>(removed.entity()));
+  // destroyed entities aren't restored as empty ones
+  EXPECT_FALSE(recovered.valid(destroyed.entity()));
+  // its slot was reused by the replayed recycled entity
+  EXPECT_EQ(entt::to_entity(recycled.entity()),
+            entt::to_entity(destroyed.entity()));
+  EXPECT_EQ(recovered.get<TestComponent>(recycled.entity()).some_value, 6UL);
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(BufferArchiveTest, roundtrip)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 7UL });
+  h.emplace<TagComponent>();
+
+  auto buffer = std::vector<std::byte>{};
+  {
+    auto archive = BufferOutputArchive{ buffer };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto loaded = entt::registry{};
+  {
+    auto archive = BufferInputArchive{ buffer };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+  EXPECT_EQ(loaded.get<TestComponent>(h.entity()).some_value, 7UL);
+  EXPECT_TRUE(loaded.all_of<TagComponent>(h.entity()));
+
+  // same encoding as cereal's binary archives
+  auto stream = std::stringstream{};
+  stream.write(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+  auto from_stream = entt::registry{};
+  {
+    auto archive = cereal::BinaryInputArchive{ stream };
+    SnapshotLoader::load(archive, from_stream, ShouldSerialize::tautology());
+  }
+  EXPECT_EQ(from_stream.get<TestComponent>(h.entity()).some_value, 7UL);
+}
+
+TEST(BufferArchiveTest, throwOnExhaustedBuffer)
+{
+  auto reg = entt::registry{};
+  createHandle(reg).emplace<TestComponent>();
+
+  auto buffer = std::array<std::byte, 8>{};
+  auto archive = BufferOutputArchive{ std::span<std::byte>{ buffer } };
+  EXPECT_THROW(Snapshot::save(archive, reg, ShouldSerialize::tautology()),
+               cereal::Exception);
+}
+
+TEST(BufferArchiveTest, loadFixed)
+{
+  auto bytes = std::array<std::byte, 12>{};
+  auto archive = BufferInputArchive{ std::span<std::byte const>{ bytes } };
+
+  auto encoded_size = std::size_t{ 0 };
+  auto value = std::uint64_t{ 1 };
+  archive.loadFixed(value, encoded_size);
+  EXPECT_EQ(value, 0UL);
+  EXPECT_EQ(encoded_size, sizeof(value));
+
+  // the remaining bytes can't hold another encoding, which is read checked
+  EXPECT_THROW(archive.loadFixed(value, encoded_size), cereal::Exception);
+}
+
+TEST(RollbackTest, restore)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+
+  auto buffer = RollbackBuffer{ 2, ShouldSerialize::tautology() };
+  buffer.capture(reg, 1);
+
+  h.replace<TestComponent>(TestComponent{ .some_value = 2UL });
+  auto created = createHandle(reg);
+  created.emplace<TagComponent>();
+  buffer.capture(reg, 2);
+
+  auto next = entt::registry{};
+  next.assign(reg.data(), reg.data() + reg.size(), reg.released());
+  auto expected = next.create();
+
+  reg.get<TestComponent>(h.entity()).some_value = 3UL;
+  reg.destroy(created.entity());
+  h.emplace<UnreflectedComponent>();
+  auto newer = createHandle(reg);
+  newer.emplace<TestComponent>();
+  createHandle(reg);
+  buffer.capture(reg, 3);
+  EXPECT_EQ(buffer.size(), 2UL);
+  EXPECT_FALSE(buffer.contains(1));
+
+  // the entity pool changed, entities are destroyed and recreated while
+  // untracked components are kept
+  buffer.restore(reg, 2);
+  EXPECT_EQ(reg.get<TestComponent>(h.entity()).some_value, 2UL);
+  EXPECT_TRUE(h.all_of<UnreflectedComponent>());
+  EXPECT_TRUE(reg.valid(created.entity()));
+  EXPECT_TRUE(reg.all_of<TagComponent>(created.entity()));
+  EXPECT_EQ(reg.alive(), 2UL);
+  EXPECT_EQ(reg.storage<TestComponent>().size(), 1UL);
+  EXPECT_EQ(reg.create(), expected);
+  EXPECT_FALSE(buffer.contains(3));
+
+  reg.get<TestComponent>(h.entity()).some_value = 4UL;
+  buffer.restore(reg, 2);
+  EXPECT_EQ(reg.get<TestComponent>(h.entity()).some_value, 2UL);
+  EXPECT_EQ(reg.alive(), 2UL);
+  EXPECT_THROW(buffer.restore(reg, 1), std::runtime_error);
+}
+
+TEST(RollbackTest, restoreInPlace)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  first.emplace<NodeComponent>(
+    NodeComponent{ .parent = entt::null, .children = {} });
+  second.emplace<NodeComponent>(
+    NodeComponent{ .parent = first.entity(), .children = {} });
+
+  auto buffer = RollbackBuffer{ 1, ShouldSerialize::tautology() };
+  buffer.capture(reg, 1);
+
+  auto listener = LoadListener{};
+  reg.on_construct<NodeComponent>().connect<&LoadListener::onConstruct>(
+    listener);
+  second.get<NodeComponent>().parent = entt::null;
+  reg.storage<NodeComponent>().swap_elements(first.entity(), second.entity());
+
+  // same entities, the values are assigned without signals
+  buffer.restore(reg, 1);
+  EXPECT_EQ(listener.constructed, 0UL);
+  EXPECT_EQ(second.get<NodeComponent>().parent, first.entity());
+  EXPECT_EQ(reg.storage<NodeComponent>().data()[0], first.entity());
+}
+
+TEST(RollbackTest, observe)
+{
+  auto reg = entt::registry{};
+  auto h = createHandle(reg);
+  h.emplace<TestComponent>(TestComponent{ .some_value = 1UL });
+
+  auto buffer = RollbackBuffer{ 3, ShouldSerialize::tautology() };
+  buffer.observe(reg);
+  buffer.capture(reg, 1);
+
+  // in-place modifications are only copied once reported
+  h.get<TestComponent>().some_value = 2UL;
+  buffer.capture(reg, 2);
+  buffer.markDirty<TestComponent>();
+  buffer.capture(reg, 3);
+
+  h.patch<TestComponent>([](auto& comp) { comp.some_value = 3UL; });
+  buffer.restore(reg, 3);
+  EXPECT_EQ(h.get<TestComponent>().some_value, 2UL);
+  buffer.restore(reg, 2);
+  EXPECT_EQ(h.get<TestComponent>().some_value, 1UL);
+
+  auto other = entt::registry{};
+  EXPECT_THROW(buffer.capture(other, 4), std::runtime_error);
+}
+
+TEST(ProfilerTest, findOutliers)
+{
+  auto reg = entt::registry{};
+  for (auto i = 0; i < 8; ++i) {
+    createHandle(reg).emplace<TestComponent>();
+  }
+  auto huge = createHandle(reg);
+  huge.emplace<NodeComponent>(NodeComponent{
+    .parent = entt::null,
+    .children = std::vector<entt::entity>(1UL << 16, entt::entity{ 0 }) });
+
+  auto profiler = Profiler{ ProfileOptions{ .top_k = 2 } };
+  auto buffer = std::vector<std::byte>{};
+  {
+    auto archive = BufferOutputArchive{ buffer };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+  auto loaded = entt::registry{};
+  {
+    auto archive = BufferInputArchive{ buffer };
+    SnapshotLoader::load(archive, loaded, ShouldSerialize::tautology());
+  }
+
+  EXPECT_EQ(profiler.entityTimes(ProfileOp::encode).count(), 9UL);
+  EXPECT_EQ(profiler.entityTimes(ProfileOp::decode).count(), 9UL);
+  for (auto op : { ProfileOp::encode, ProfileOp::decode }) {
+    auto slowest = profiler.slowestComponents(op);
+    ASSERT_EQ(slowest.size(), 2UL);
+    EXPECT_EQ(slowest.front().e, huge.entity());
+    EXPECT_EQ(slowest.front().component, NODE_COMPONENT_NAME);
+    EXPECT_GT(slowest.front().bytes, 1UL << 16);
+  }
+  EXPECT_NE(profiler.report().find(NODE_COMPONENT_NAME), std::string::npos);
+}
+
+TEST(ProfilerTest, skipUndecoded)
+{
+  auto reg = entt::registry{};
+  auto first = createHandle(reg);
+  auto second = createHandle(reg);
+  first.emplace<TestComponent>();
+  first.emplace<OtherComponent>();
+  second.emplace<TestComponent>();
+
+  auto buffer = std::vector<std::byte>{};
+  {
+    auto archive = BufferOutputArchive{ buffer };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+  }
+
+  auto profiler = Profiler{};
+  auto loaded = entt::registry{};
+  {
+    auto archive = BufferInputArchive{ buffer };
+    auto only_test = ShouldSerializePred{ [](char const* name) {
+      return name == TEST_COMPONENT_NAME;
+    } };
+    SnapshotLoader::load(archive,
+                         loaded,
+                         only_test,
+                         ShouldLoadEntity::range(first.entity(),
+                                                 second.entity()));
+  }
+
+  // the skipped entity and component are neither timed nor counted
+  auto samples = profiler.slowestEntities(ProfileOp::decode);
+  ASSERT_EQ(samples.size(), 1UL);
+  EXPECT_EQ(samples.front().e, first.entity());
+  auto const& totals = profiler.componentTotals(ProfileOp::decode);
+  ASSERT_EQ(totals.size(), 1UL);
+  EXPECT_EQ(samples.front().bytes, totals.begin()->second.bytes);
+}
+
+TEST(ProfilerTest, sample)
+{
+  auto reg = entt::registry{};
+  for (auto i = 0; i < 8; ++i) {
+    createHandle(reg).emplace<TestComponent>();
+  }
+
+  auto stream = std::stringstream{};
+  {
+    auto profiler = Profiler{ ProfileOptions{ .sample_interval = 4 } };
+    auto archive = cereal::BinaryOutputArchive{ stream };
+    Snapshot::save(archive, reg, ShouldSerialize::tautology());
+    EXPECT_EQ(profiler.entityTimes(ProfileOp::encode).count(), 2UL);
+
+    // sizes are recorded for every entity
+    EXPECT_EQ(profiler.entityBytes(ProfileOp::encode).count(), 8UL);
+    auto const& totals = profiler.componentTotals(ProfileOp::encode);
+    auto const& test_totals = totals.find(TEST_COMPONENT_NAME)->second;
+    EXPECT_EQ(test_totals.count, 8UL);
+    EXPECT_EQ(test_totals.timed, 2UL);
+  }
+  EXPECT_EQ(Profiler::active(), nullptr);
+}
+
+TEST(ProfilerTest, destroyOutOfOrder)
+{
+  auto outer = std::make_unique<Profiler>();
+  auto inner = std::make_unique<Profiler>();
+
+  outer.reset();
+  EXPECT_EQ(Profiler::active(), inner.get());
+  inner.reset();
+  EXPECT_EQ(Profiler::active(), nullptr);
+}
+
 // TODO: add snapshot tests
 
 int
 main(int argc, char** argv)
 {
-  reflectComponent<TestComponent, TEST_COMPONENT_NAME>();
-  reflectComponent<OtherComponent, OTHER_COMPONENT_NAME>();
+  registerTestComponents();
 
   ::testing::InitGoogleTest(&argc, argv);
 
@@ -0,0 +1,7 @@
+#include "components.hpp"
+
+void
+registerSnapshotComponents()
+{
+  registerTestComponents();
+}
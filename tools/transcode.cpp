@@ -0,0 +1,15 @@
+#include <entt_snapshot/Transcoder.hpp>
+
+/**
+ * Defined by the sources passed to entt_snapshot_add_transcoder, reflects all
+ * components which may occur in the snapshots to be converted.
+ * */
+void
+registerSnapshotComponents();
+
+int
+main(int argc, char** argv)
+{
+  registerSnapshotComponents();
+  return snapshot::Transcoder::main(argc, argv);
+}